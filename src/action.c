@@ -0,0 +1,162 @@
+#include<stdlib.h>
+#include<string.h>
+
+#include "wm.h"
+#include "action.h"
+#include "bar.h"
+
+// Splits "name rest of string" into the name and a pointer to the rest
+static const char* next_word(const char *string, char *word, size_t size)
+{
+    size_t len = 0;
+
+    while(*string == ' ' || *string == '\t')
+        string++;
+    while(*string != '\0' && *string != ' ' && *string != '\t' && *string != '\n')
+    {
+        if(len + 1 < size)
+            word[len++] = *string;
+        string++;
+    }
+    word[len] = '\0';
+
+    while(*string == ' ' || *string == '\t')
+        string++;
+    return string;
+}
+
+const char* action_parse(const char *string, action_t *action)
+{
+    char name[32], *end = NULL;
+    const char *rest = next_word(string, name, sizeof(name));
+
+    memset(action, 0, sizeof(action_t));
+    action->relative = rest[0] == '+' || rest[0] == '-';
+
+    if(strcmp(name, "focus") == 0)
+    {
+        if(strncmp(rest, "next", 4) == 0)
+            action->type = ACTION_FOCUS_NEXT;
+        else if(strncmp(rest, "prev", 4) == 0)
+            action->type = ACTION_FOCUS_PREV;
+        else if(strncmp(rest, "last", 4) == 0)
+            action->type = ACTION_FOCUS_LAST;
+        else
+        {
+            action->type = ACTION_FOCUS_WINDOW;
+            action->i = strtol(rest, &end, 0);
+            if(end == rest)
+                return "focus expects next, prev, last or a window id";
+        }
+    }
+    else if(strcmp(name, "masters") == 0)
+    {
+        action->type = ACTION_MASTERS;
+        action->i = strtol(rest, &end, 10);
+        if(end == rest)
+            return "masters expects a number";
+    }
+    else if(strcmp(name, "weight") == 0)
+    {
+        action->type = ACTION_WEIGHT;
+        action->f = strtof(rest, &end);
+        if(end == rest)
+            return "weight expects a number";
+    }
+    else if(strcmp(name, "spawn") == 0)
+    {
+        action->type = ACTION_SPAWN;
+        if(rest[0] == '\0')
+            return "spawn expects a command";
+        else if(strlen(rest) >= sizeof(action->arg))
+            return "spawn command is too long";
+        strcpy(action->arg, rest);
+        // Strip trailing newline from e.g. echo
+        action->arg[strcspn(action->arg, "\n")] = '\0';
+    }
+    else if(strcmp(name, "status") == 0)
+    {
+        action->type = ACTION_STATUS;
+        strncpy(action->arg, rest, sizeof(action->arg)-1);
+        action->arg[strcspn(action->arg, "\n")] = '\0';
+    }
+    else if(strcmp(name, "layout") == 0)
+    {
+        action->type = ACTION_LAYOUT;
+        if(strncmp(rest, "tile", 4) == 0)
+            action->i = LAYOUT_TILE;
+        else if(strncmp(rest, "monocle", 7) == 0)
+            action->i = LAYOUT_MONOCLE;
+        else if(strncmp(rest, "toggle", 6) == 0)
+            action->i = -1;
+        else
+            return "layout expects tile, monocle or toggle";
+    }
+    else if(strcmp(name, "fullscreen") == 0)
+        action->type = ACTION_FULLSCREEN;
+    else if(strcmp(name, "close") == 0)
+        action->type = ACTION_CLOSE;
+    else if(strcmp(name, "quit") == 0)
+        action->type = ACTION_QUIT;
+    else
+        return "unknown command";
+
+    return NULL;
+}
+
+const char* action_run(const action_t *action)
+{
+    client_t *client = NULL;
+
+    switch(action->type)
+    {
+        case ACTION_FOCUS_NEXT:
+            focus_next();
+            break;
+        case ACTION_FOCUS_PREV:
+            focus_prev();
+            break;
+        case ACTION_FOCUS_LAST:
+            focus_last();
+            break;
+        case ACTION_FOCUS_WINDOW:
+            client = client_from_window((Window)action->i, NULL);
+            if(client == NULL)
+                client = client_from_frame((Window)action->i, NULL);
+            if(client == NULL)
+                return "no such window";
+            focus_client(client);
+            break;
+        case ACTION_MASTERS:
+            update_masters(action->relative ? action->i : action->i - wm.masters);
+            break;
+        case ACTION_WEIGHT:
+            update_master_weight(action->relative ? action->f : action->f - wm.master_weight);
+            break;
+        case ACTION_SPAWN:
+            exec(action->arg);
+            break;
+        case ACTION_CLOSE:
+            close_client(wm.focus);
+            break;
+        case ACTION_LAYOUT:
+            if(action->i < 0)
+                set_layout(wm.layout == LAYOUT_TILE ? LAYOUT_MONOCLE : LAYOUT_TILE);
+            else
+                set_layout(action->i);
+            break;
+        case ACTION_FULLSCREEN:
+            if(wm.focus != NULL)
+                set_fullscreen(wm.focus, !wm.focus->fullscreen);
+            break;
+        case ACTION_STATUS:
+            bar_set(BAR_SEGMENT_STATUS, action->arg);
+            break;
+        case ACTION_QUIT:
+            wm.running = false;
+            break;
+        default:
+            break;
+    }
+    return NULL;
+}
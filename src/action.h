@@ -0,0 +1,40 @@
+#ifndef ACTION_H
+#define ACTION_H
+
+#include<stdbool.h>
+
+// Actions are the things the WM can be told to do
+// They're parsed from plain text, e.g. "focus next" or "masters +1"
+// so the same commands can be sent over IPC
+typedef enum
+{
+    ACTION_NONE = 0,
+    ACTION_FOCUS_NEXT,
+    ACTION_FOCUS_PREV,
+    ACTION_FOCUS_LAST,
+    ACTION_FOCUS_WINDOW, // window id in i
+    ACTION_MASTERS,      // i, relative if prefixed with + or -
+    ACTION_WEIGHT,       // f, relative if prefixed with + or -
+    ACTION_SPAWN,        // shell command in arg
+    ACTION_CLOSE,
+    ACTION_FULLSCREEN,   // Toggles the focused client
+    ACTION_LAYOUT,       // i is a layout_t or -1 to toggle
+    ACTION_STATUS,       // Bar status text in arg
+    ACTION_QUIT,
+} action_type_t;
+
+typedef struct
+{
+    action_type_t type;
+    bool relative;
+    long i;
+    float f;
+    char arg[256];
+} action_t;
+
+// Returns NULL on success, otherwise a string describing what's wrong
+const char* action_parse(const char *string, action_t *action);
+// Same for running it, only "focus <window>" can fail here(not a window of ours)
+const char* action_run(const action_t *action);
+
+#endif
@@ -0,0 +1,340 @@
+#include<string.h>
+#include<time.h>
+#include<sys/ipc.h>
+#include<sys/shm.h>
+#include<X11/Xutil.h>
+#include<X11/extensions/XShm.h>
+
+#include "wm.h"
+#include "bar.h"
+#include "stack.h"
+
+#define BAR_PADDING 6
+
+typedef struct
+{
+    char text[256];
+    int x, width;
+    bool damaged;
+} segment_t;
+
+typedef struct
+{
+    Window window;
+    Pixmap buffer; // Everything is drawn here first
+    GC gc;
+    XFontStruct *font;
+    bool font_loaded; // false if it's the GC's default font from XQueryFont
+    int width, height;
+    unsigned long foreground, background;
+
+    // MIT-SHM backing for the buffer, lets backgrounds be filled
+    // straight into memory instead of sending fill requests
+    bool shm;
+    XShmSegmentInfo shm_info;
+    XImage *image;
+    unsigned long last_serial; // Last request which touched the buffer
+
+    segment_t segments[BAR_SEGMENTS];
+    time_t clock_minute;
+} bar_t;
+static bar_t bar;
+
+static void create_buffer(void)
+{
+    int screen = DefaultScreen(wm.dpy), major = 0, minor = 0;
+    int depth = DefaultDepth(wm.dpy, screen);
+    Bool pixmaps = False;
+
+    if(XShmQueryVersion(wm.dpy, &major, &minor, &pixmaps) && pixmaps
+            && XShmPixmapFormat(wm.dpy) == ZPixmap)
+    {
+        bar.image = XShmCreateImage(wm.dpy, DefaultVisual(wm.dpy, screen), depth,
+                ZPixmap, NULL, &bar.shm_info, bar.width, bar.height);
+    }
+
+    if(bar.image != NULL && bar.image->bits_per_pixel == 32)
+    {
+        bar.shm_info.shmid = shmget(IPC_PRIVATE, bar.image->bytes_per_line * bar.height, IPC_CREAT | 0600);
+        bar.shm_info.shmaddr = bar.shm_info.shmid < 0 ? (void*)-1 : shmat(bar.shm_info.shmid, NULL, 0);
+        bar.shm_info.readOnly = False;
+
+        if(bar.shm_info.shmaddr != (void*)-1 && XShmAttach(wm.dpy, &bar.shm_info))
+        {
+            bar.image->data = bar.shm_info.shmaddr;
+            bar.buffer = XShmCreatePixmap(wm.dpy, bar.window, bar.shm_info.shmaddr,
+                    &bar.shm_info, bar.width, bar.height, depth);
+            // Segment gets freed once both sides detach
+            XSync(wm.dpy, False);
+            shmctl(bar.shm_info.shmid, IPC_RMID, NULL);
+            bar.shm = true;
+            return;
+        }
+
+        if(bar.shm_info.shmaddr != (void*)-1)
+            shmdt(bar.shm_info.shmaddr);
+        if(bar.shm_info.shmid >= 0)
+            shmctl(bar.shm_info.shmid, IPC_RMID, NULL);
+    }
+
+    if(bar.image != NULL)
+    {
+        XDestroyImage(bar.image);
+        bar.image = NULL;
+    }
+
+    LOG("MIT-SHM not available for the bar, using a normal pixmap");
+    bar.buffer = XCreatePixmap(wm.dpy, bar.window, bar.width, bar.height, depth);
+}
+
+static void fill_background(int x, int width)
+{
+    if(!bar.shm)
+    {
+        XSetForeground(wm.dpy, bar.gc, bar.background);
+        XFillRectangle(wm.dpy, bar.buffer, bar.gc, x, 0, width, bar.height);
+        return;
+    }
+
+    // The server might still be reading this part of the buffer
+    if(LastKnownRequestProcessed(wm.dpy) < bar.last_serial)
+        XSync(wm.dpy, False);
+
+    for(int y = 0; y < bar.height; y++)
+    {
+        unsigned int *row = (unsigned int*)(bar.image->data + y * bar.image->bytes_per_line);
+        for(int i = x; i < x + width; i++)
+            row[i] = bar.background;
+    }
+}
+
+static int text_width(const char *text)
+{
+    if(text[0] == '\0')
+        return 0;
+    return XTextWidth(bar.font, text, strlen(text)) + BAR_PADDING * 2;
+}
+
+// Segments are packed left to right with the title taking what's left
+// Only segments whose position or size changed get damaged
+static void layout_segments(void)
+{
+    segment_t *segments = bar.segments;
+    int x[BAR_SEGMENTS], width[BAR_SEGMENTS];
+
+    width[BAR_SEGMENT_LAYOUT] = text_width(segments[BAR_SEGMENT_LAYOUT].text);
+    width[BAR_SEGMENT_STATUS] = text_width(segments[BAR_SEGMENT_STATUS].text);
+    width[BAR_SEGMENT_CLOCK] = text_width(segments[BAR_SEGMENT_CLOCK].text);
+    width[BAR_SEGMENT_TITLE] = bar.width - width[BAR_SEGMENT_LAYOUT]
+        - width[BAR_SEGMENT_STATUS] - width[BAR_SEGMENT_CLOCK];
+    if(width[BAR_SEGMENT_TITLE] < 0)
+        width[BAR_SEGMENT_TITLE] = 0;
+
+    x[0] = 0;
+    for(int i = 1; i < BAR_SEGMENTS; i++)
+        x[i] = x[i-1] + width[i-1];
+
+    for(int i = 0; i < BAR_SEGMENTS; i++)
+    {
+        if(segments[i].x != x[i] || segments[i].width != width[i])
+            segments[i].damaged = true;
+        segments[i].x = x[i];
+        segments[i].width = width[i];
+    }
+}
+
+void bar_init(int width, int height, long foreground, long background)
+{
+    XSetWindowAttributes attrs = {0};
+
+    memset(&bar, 0, sizeof(bar));
+    if(height <= 0)
+        return;
+
+    bar.width = width;
+    bar.height = height;
+    bar.foreground = foreground;
+    bar.background = background;
+
+    // Override redirect so the WM doesn't try to manage its own bar
+    attrs.override_redirect = True;
+    attrs.background_pixmap = None; // Expose is answered from the buffer
+    attrs.event_mask = ExposureMask;
+    bar.window = XCreateWindow(wm.dpy, wm.root, 0, 0, width, height, 0,
+            CopyFromParent, InputOutput, CopyFromParent,
+            CWOverrideRedirect | CWBackPixmap | CWEventMask, &attrs);
+
+    bar.gc = XCreateGC(wm.dpy, bar.window, 0, NULL);
+    bar.font = XLoadQueryFont(wm.dpy, "fixed");
+    bar.font_loaded = bar.font != NULL;
+    if(bar.font_loaded)
+        XSetFont(wm.dpy, bar.gc, bar.font->fid);
+    else // Whatever the server gave the GC, only the metrics are needed
+        bar.font = XQueryFont(wm.dpy, XGContextFromGC(bar.gc));
+
+    // Nothing to measure or draw text with, no bar then
+    if(bar.font == NULL)
+    {
+        LOG("No font for the bar, not showing it");
+        XFreeGC(wm.dpy, bar.gc);
+        XDestroyWindow(wm.dpy, bar.window);
+        bar.window = None;
+        return;
+    }
+
+    create_buffer();
+
+    // Draw everything once
+    fill_background(0, width);
+    bar_tick();
+    layout_segments();
+
+    stack_add_fixed(bar.window, STACK_BAR);
+    XMapWindow(wm.dpy, bar.window);
+}
+
+void bar_deinit(void)
+{
+    if(bar.window == None)
+        return;
+
+    if(bar.shm)
+    {
+        XShmDetach(wm.dpy, &bar.shm_info);
+        XFreePixmap(wm.dpy, bar.buffer);
+        XSync(wm.dpy, False);
+        shmdt(bar.shm_info.shmaddr);
+        bar.image->data = NULL;
+        XDestroyImage(bar.image);
+    }
+    else
+        XFreePixmap(wm.dpy, bar.buffer);
+
+    // XFreeFont() would also unload the GC's font, that one only gets
+    // its XQueryFont() info freed, per_char included
+    if(bar.font_loaded)
+        XFreeFont(wm.dpy, bar.font);
+    else
+        XFreeFontInfo(NULL, bar.font, 1);
+    XFreeGC(wm.dpy, bar.gc);
+    stack_remove(bar.window);
+    XDestroyWindow(wm.dpy, bar.window);
+    bar.window = None;
+}
+
+int bar_height(void)
+{
+    return bar.window != None ? bar.height : 0;
+}
+
+bool bar_owns(Window window)
+{
+    return window != None && window == bar.window;
+}
+
+// Everything has to be redrawn, but nothing moves
+void bar_set_colors(long foreground, long background)
+{
+    if(bar.window == None)
+        return;
+
+    bar.foreground = foreground;
+    bar.background = background;
+    for(int i = 0; i < BAR_SEGMENTS; i++)
+        bar.segments[i].damaged = true;
+}
+
+void bar_set(enum bar_segment_t segment, const char *text)
+{
+    segment_t *seg = &bar.segments[segment];
+
+    if(bar.window == None || bar.font == NULL || strncmp(seg->text, text, sizeof(seg->text)-1) == 0)
+        return;
+
+    strncpy(seg->text, text, sizeof(seg->text)-1);
+    seg->damaged = true;
+    layout_segments();
+}
+
+void bar_set_title(Window window)
+{
+    char *name = NULL;
+
+    if(bar.window == None)
+        return;
+
+    if(window != None && XFetchName(wm.dpy, window, &name) && name != NULL)
+    {
+        bar_set(BAR_SEGMENT_TITLE, name);
+        XFree(name);
+    }
+    else
+        bar_set(BAR_SEGMENT_TITLE, "");
+}
+
+// The buffer always has the complete bar so exposes are just a copy
+void bar_expose(XExposeEvent *event)
+{
+    XCopyArea(wm.dpy, bar.buffer, bar.window, bar.gc,
+            event->x, event->y, event->width, event->height, event->x, event->y);
+}
+
+int bar_timeout(void)
+{
+    if(bar.window == None)
+        return -1;
+
+    // Wake up right after the next minute starts
+    return (60 - time(NULL) % 60) * 1000;
+}
+
+void bar_tick(void)
+{
+    time_t now = time(NULL);
+    char clock[16];
+
+    if(bar.window == None || now / 60 == bar.clock_minute)
+        return;
+
+    bar.clock_minute = now / 60;
+    strftime(clock, sizeof(clock), "%H:%M", localtime(&now));
+    bar_set(BAR_SEGMENT_CLOCK, clock);
+}
+
+void bar_flush(void)
+{
+    XRectangle clip;
+    bool drawn = false;
+
+    if(bar.window == None)
+        return;
+
+    for(int i = 0; i < BAR_SEGMENTS; i++)
+    {
+        segment_t *seg = &bar.segments[i];
+        if(!seg->damaged)
+            continue;
+        seg->damaged = false;
+
+        if(seg->width <= 0)
+            continue;
+
+        fill_background(seg->x, seg->width);
+
+        // Clip so a long title can't spill into the status
+        clip = (XRectangle){ .x = seg->x, .y = 0, .width = seg->width, .height = bar.height };
+        XSetClipRectangles(wm.dpy, bar.gc, 0, 0, &clip, 1, Unsorted);
+        XSetForeground(wm.dpy, bar.gc, bar.foreground);
+        XDrawString(wm.dpy, bar.buffer, bar.gc,
+                seg->x + BAR_PADDING, (bar.height + bar.font->ascent - bar.font->descent) / 2,
+                seg->text, strlen(seg->text));
+        XSetClipMask(wm.dpy, bar.gc, None);
+
+        XCopyArea(wm.dpy, bar.buffer, bar.window, bar.gc,
+                seg->x, 0, seg->width, bar.height, seg->x, 0);
+        drawn = true;
+    }
+
+    if(drawn)
+        bar.last_serial = NextRequest(wm.dpy) - 1;
+}
@@ -0,0 +1,34 @@
+#ifndef BAR_H
+#define BAR_H
+
+#include<X11/Xlib.h>
+#include<stdbool.h>
+
+// Built-in status bar along the top of the screen
+// Everything is drawn into an off-screen pixmap and only the
+// segments which actually changed are redrawn and copied over,
+// so an idle bar costs nothing
+enum bar_segment_t
+{
+    BAR_SEGMENT_LAYOUT = 0, // Layout symbol and client count, left
+    BAR_SEGMENT_TITLE,      // Focused window's title
+    BAR_SEGMENT_STATUS,     // Set over IPC by status producers
+    BAR_SEGMENT_CLOCK,      // Right
+    BAR_SEGMENTS
+};
+
+void bar_init(int width, int height, long foreground, long background);
+void bar_deinit(void);
+int bar_height(void); // 0 if there's no bar
+
+void bar_set_colors(long foreground, long background);
+void bar_set(enum bar_segment_t segment, const char *text);
+void bar_set_title(Window window);
+void bar_expose(XExposeEvent *event);
+bool bar_owns(Window window);
+
+int bar_timeout(void); // ms until the clock needs updating, for poll()
+void bar_tick(void);
+void bar_flush(void); // Redraw and copy damaged segments, once per main loop iteration
+
+#endif
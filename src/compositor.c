@@ -0,0 +1,466 @@
+#include<stdlib.h>
+#include<string.h>
+#include<time.h>
+#include<X11/Xutil.h>
+#include<X11/extensions/Xcomposite.h>
+#include<X11/extensions/Xdamage.h>
+#include<X11/extensions/Xfixes.h>
+#include<X11/extensions/Xrender.h>
+#include<X11/extensions/shape.h>
+
+#include "wm.h"
+#include "ipc.h"
+#include "compositor.h"
+
+// Frame time gets logged every STATS_FRAMES composited frames
+#define STATS_FRAMES 300
+
+typedef struct
+{
+    Window window;
+    Damage damage;
+    XRenderPictFormat *format;
+    Pixmap pixmap;   // Offscreen contents, border included
+    Picture picture; // Created on first paint, None after unmap/resize
+    int x, y, width, height, border;
+    bool mapped;
+} comp_window_t;
+
+typedef struct
+{
+    bool active;
+    int damage_event;
+
+    Window overlay;  // None while a fullscreen client is unredirected
+    Picture target;  // On the overlay
+    Pixmap buffer_pixmap;
+    Picture buffer;  // Everything is composited here first
+    int width, height;
+
+    XserverRegion damaged; // Screen coordinates, what the next frame repaints
+    bool dirty;
+    Window unredirected;
+
+    comp_window_t *windows; // Bottom to top, same as the server's stacking order
+    int len, capacity;
+
+    int frames;
+    double total_ms, max_ms;
+} compositor_t;
+static compositor_t comp;
+
+static double now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static int find(Window window)
+{
+    for(int i = 0; i < comp.len; i++)
+        if(comp.windows[i].window == window)
+            return i;
+    return -1;
+}
+
+static void damage_rect(int x, int y, int width, int height)
+{
+    XRectangle rect = { x, y, width, height };
+    XserverRegion region = XFixesCreateRegion(wm.dpy, &rect, 1);
+
+    XFixesUnionRegion(wm.dpy, comp.damaged, comp.damaged, region);
+    XFixesDestroyRegion(wm.dpy, region);
+    comp.dirty = true;
+}
+
+static void damage_window(comp_window_t *window)
+{
+    if(window->mapped)
+        damage_rect(window->x, window->y,
+                window->width + 2 * window->border, window->height + 2 * window->border);
+}
+
+// The pixmap is reallocated by the server on map and resize
+static void release_picture(comp_window_t *window)
+{
+    if(window->picture != None)
+        XRenderFreePicture(wm.dpy, window->picture);
+    if(window->pixmap != None)
+        XFreePixmap(wm.dpy, window->pixmap);
+    window->picture = None;
+    window->pixmap = None;
+}
+
+static void add_window(Window id, int index)
+{
+    XWindowAttributes attrs;
+    comp_window_t *window = NULL;
+
+    if(id == comp.overlay || find(id) >= 0)
+        return;
+    if(!XGetWindowAttributes(wm.dpy, id, &attrs) || attrs.class == InputOnly)
+        return;
+
+    if(comp.len == comp.capacity)
+    {
+        int capacity = comp.capacity == 0 ? 32 : comp.capacity * 2;
+        comp_window_t *windows = realloc(comp.windows, capacity * sizeof(comp_window_t));
+        if(windows == NULL)
+            return;
+        comp.windows = windows;
+        comp.capacity = capacity;
+    }
+
+    if(index < 0 || index > comp.len)
+        index = comp.len;
+    memmove(&comp.windows[index + 1], &comp.windows[index], (comp.len - index) * sizeof(comp_window_t));
+    comp.len++;
+
+    window = &comp.windows[index];
+    memset(window, 0, sizeof(comp_window_t));
+    window->window = id;
+    window->format = XRenderFindVisualFormat(wm.dpy, attrs.visual);
+    window->damage = XDamageCreate(wm.dpy, id, XDamageReportNonEmpty);
+    window->x = attrs.x;
+    window->y = attrs.y;
+    window->width = attrs.width;
+    window->height = attrs.height;
+    window->border = attrs.border_width;
+    window->mapped = attrs.map_state == IsViewable;
+    damage_window(window);
+}
+
+// Damage objects go away with their window, so only
+// destroy it if the window is still around
+static void remove_window(int index, bool destroyed)
+{
+    comp_window_t *window = &comp.windows[index];
+
+    damage_window(window);
+    release_picture(window);
+    if(!destroyed)
+        XDamageDestroy(wm.dpy, window->damage);
+
+    comp.len--;
+    memmove(&comp.windows[index], &comp.windows[index + 1], (comp.len - index) * sizeof(comp_window_t));
+}
+
+// Moves windows[index] to right above the window `above`, None means the bottom
+static void restack(int index, Window above)
+{
+    comp_window_t window = comp.windows[index];
+    int to = 0;
+
+    comp.len--;
+    memmove(&comp.windows[index], &comp.windows[index + 1], (comp.len - index) * sizeof(comp_window_t));
+
+    // Siblings we don't track(InputOnly) leave it where it was
+    if(above != None)
+        to = find(above) < 0 ? index : find(above) + 1;
+    memmove(&comp.windows[to + 1], &comp.windows[to], (comp.len - to) * sizeof(comp_window_t));
+    comp.windows[to] = window;
+    comp.len++;
+}
+
+static bool acquire_overlay(void)
+{
+    XserverRegion empty = None;
+    XRenderPictureAttributes attrs = { .subwindow_mode = IncludeInferiors };
+
+    comp.overlay = XCompositeGetOverlayWindow(wm.dpy, wm.root);
+    if(comp.overlay == None)
+        return false;
+
+    // Clicks go through to whatever is underneath
+    empty = XFixesCreateRegion(wm.dpy, NULL, 0);
+    XFixesSetWindowShapeRegion(wm.dpy, comp.overlay, ShapeInput, 0, 0, empty);
+    XFixesDestroyRegion(wm.dpy, empty);
+    XSelectInput(wm.dpy, comp.overlay, ExposureMask);
+
+    comp.target = XRenderCreatePicture(wm.dpy, comp.overlay,
+            XRenderFindVisualFormat(wm.dpy, DefaultVisual(wm.dpy, DefaultScreen(wm.dpy))),
+            CPSubwindowMode, &attrs);
+    damage_rect(0, 0, comp.width, comp.height);
+    return true;
+}
+
+static void release_overlay(void)
+{
+    if(comp.overlay == None)
+        return;
+    XRenderFreePicture(wm.dpy, comp.target);
+    XCompositeReleaseOverlayWindow(wm.dpy, wm.root);
+    comp.target = None;
+    comp.overlay = None;
+}
+
+bool compositor_init(void)
+{
+    int screen = DefaultScreen(wm.dpy);
+    int event = 0, error = 0, major = 0, minor = 0;
+    Window root = None, parent = None, *children = NULL;
+    unsigned int len = 0;
+
+    if(comp.active)
+        return true;
+
+    if(!XCompositeQueryExtension(wm.dpy, &event, &error)
+            || !XCompositeQueryVersion(wm.dpy, &major, &minor)
+            || (major == 0 && minor < 3) // Overlay window
+            || !XDamageQueryExtension(wm.dpy, &comp.damage_event, &error)
+            || !XFixesQueryExtension(wm.dpy, &event, &error)
+            || !XRenderQueryExtension(wm.dpy, &event, &error))
+    {
+        LOG("Compositor: missing Composite, Damage, XFixes or Render");
+        return false;
+    }
+
+    comp.width = DisplayWidth(wm.dpy, screen);
+    comp.height = DisplayHeight(wm.dpy, screen);
+    comp.damaged = XFixesCreateRegion(wm.dpy, NULL, 0);
+    comp.buffer_pixmap = XCreatePixmap(wm.dpy, wm.root, comp.width, comp.height, DefaultDepth(wm.dpy, screen));
+    comp.buffer = XRenderCreatePicture(wm.dpy, comp.buffer_pixmap,
+            XRenderFindVisualFormat(wm.dpy, DefaultVisual(wm.dpy, screen)), 0, NULL);
+
+    if(!acquire_overlay())
+    {
+        LOG("Compositor: can't get the overlay window");
+        XRenderFreePicture(wm.dpy, comp.buffer);
+        XFreePixmap(wm.dpy, comp.buffer_pixmap);
+        XFixesDestroyRegion(wm.dpy, comp.damaged);
+        return false;
+    }
+
+    // Nothing can change between reading the tree and redirecting it
+    XGrabServer(wm.dpy);
+    XCompositeRedirectSubwindows(wm.dpy, wm.root, CompositeRedirectManual);
+    if(XQueryTree(wm.dpy, wm.root, &root, &parent, &children, &len))
+    {
+        // Already bottom to top
+        for(unsigned int i = 0; i < len; i++)
+            add_window(children[i], -1);
+        XFree(children);
+    }
+    XUngrabServer(wm.dpy);
+
+    comp.active = true;
+    comp.unredirected = None;
+    LOG("Compositor: %d windows", comp.len);
+    return true;
+}
+
+void compositor_deinit(void)
+{
+    if(!comp.active)
+        return;
+
+    while(comp.len > 0)
+        remove_window(comp.len - 1, false);
+    free(comp.windows);
+
+    // A fullscreen client that's unredirected right now stays that way,
+    // redirecting it back would leave it invisible with nobody compositing
+    XCompositeUnredirectSubwindows(wm.dpy, wm.root, CompositeRedirectManual);
+    comp.unredirected = None;
+    release_overlay();
+    XRenderFreePicture(wm.dpy, comp.buffer);
+    XFreePixmap(wm.dpy, comp.buffer_pixmap);
+    XFixesDestroyRegion(wm.dpy, comp.damaged);
+
+    memset(&comp, 0, sizeof(comp));
+}
+
+bool compositor_active(void)
+{
+    return comp.active;
+}
+
+bool compositor_event(XEvent *ev)
+{
+    int i = -1;
+
+    if(ev->type == comp.damage_event + XDamageNotify)
+    {
+        XDamageNotifyEvent *event = (XDamageNotifyEvent*)ev;
+        XserverRegion parts = None;
+
+        i = find(event->drawable);
+        if(i < 0)
+            return true;
+
+        // Damage is relative to the inside of the border
+        parts = XFixesCreateRegion(wm.dpy, NULL, 0);
+        XDamageSubtract(wm.dpy, event->damage, None, parts);
+        XFixesTranslateRegion(wm.dpy, parts,
+                comp.windows[i].x + comp.windows[i].border, comp.windows[i].y + comp.windows[i].border);
+        XFixesUnionRegion(wm.dpy, comp.damaged, comp.damaged, parts);
+        XFixesDestroyRegion(wm.dpy, parts);
+        comp.dirty = true;
+        return true;
+    }
+
+    // Only the top level windows are composited, their
+    // children are part of the parent's offscreen pixmap
+    switch(ev->type)
+    {
+        case Expose:
+            if(ev->xexpose.window != comp.overlay)
+                return false;
+            damage_rect(ev->xexpose.x, ev->xexpose.y, ev->xexpose.width, ev->xexpose.height);
+            return true;
+        case CreateNotify:
+            if(ev->xcreatewindow.parent == wm.root)
+                add_window(ev->xcreatewindow.window, -1); // New windows start on top
+            break;
+        case DestroyNotify:
+            if(ev->xdestroywindow.event == wm.root && (i = find(ev->xdestroywindow.window)) >= 0)
+                remove_window(i, true);
+            break;
+        case ReparentNotify:
+            if(ev->xreparent.event != wm.root)
+                break;
+            if(ev->xreparent.parent == wm.root)
+                add_window(ev->xreparent.window, -1);
+            else if((i = find(ev->xreparent.window)) >= 0)
+                remove_window(i, false);
+            break;
+        case MapNotify:
+            if(ev->xmap.event == wm.root && (i = find(ev->xmap.window)) >= 0)
+            {
+                comp.windows[i].mapped = true;
+                release_picture(&comp.windows[i]);
+                damage_window(&comp.windows[i]);
+            }
+            break;
+        case UnmapNotify:
+            if(ev->xunmap.event == wm.root && (i = find(ev->xunmap.window)) >= 0)
+            {
+                damage_window(&comp.windows[i]);
+                comp.windows[i].mapped = false;
+                release_picture(&comp.windows[i]);
+            }
+            break;
+        case ConfigureNotify:
+            if(ev->xconfigure.event == wm.root && (i = find(ev->xconfigure.window)) >= 0)
+            {
+                XConfigureEvent *event = &ev->xconfigure;
+                comp_window_t *window = &comp.windows[i];
+
+                damage_window(window);
+                if(window->width != event->width || window->height != event->height
+                        || window->border != event->border_width)
+                    release_picture(window);
+                window->x = event->x;
+                window->y = event->y;
+                window->width = event->width;
+                window->height = event->height;
+                window->border = event->border_width;
+                damage_window(window);
+
+                restack(i, event->above);
+            }
+            break;
+        case CirculateNotify:
+            if(ev->xcirculate.event == wm.root && (i = find(ev->xcirculate.window)) >= 0)
+            {
+                damage_window(&comp.windows[i]);
+                restack(i, ev->xcirculate.place == PlaceOnTop ? comp.windows[comp.len - 1].window : None);
+            }
+            break;
+    }
+
+    return false;
+}
+
+// A fullscreen client covers everything, so it's taken out of
+// compositing and drawn straight to the screen. The overlay has
+// to go as well or it would cover it
+static void update_unredirected(void)
+{
+    Window want = wm.fullscreen != NULL ? wm.fullscreen->frame : None;
+    int i = -1;
+
+    if(want == comp.unredirected)
+        return;
+
+    if(comp.unredirected != None)
+    {
+        XCompositeRedirectWindow(wm.dpy, comp.unredirected, CompositeRedirectManual);
+        if((i = find(comp.unredirected)) >= 0)
+            release_picture(&comp.windows[i]);
+    }
+
+    if(want != None)
+    {
+        XCompositeUnredirectWindow(wm.dpy, want, CompositeRedirectManual);
+        release_overlay();
+    }
+    else if(comp.overlay == None)
+        acquire_overlay();
+
+    comp.unredirected = want;
+}
+
+void compositor_flush(void)
+{
+    XRenderColor black = { 0, 0, 0, 0xffff };
+    double start = 0.0, ms = 0.0;
+
+    if(!comp.active)
+        return;
+
+    update_unredirected();
+    if(comp.unredirected != None || !comp.dirty)
+        return; // Skipped, nothing to do
+
+    start = now_ms();
+
+    // Only the damaged area is touched, in the buffer and on screen
+    XFixesSetPictureClipRegion(wm.dpy, comp.buffer, 0, 0, comp.damaged);
+    XRenderFillRectangle(wm.dpy, PictOpSrc, comp.buffer, &black, 0, 0, comp.width, comp.height);
+
+    for(int i = 0; i < comp.len; i++)
+    {
+        comp_window_t *window = &comp.windows[i];
+        int width = window->width + 2 * window->border, height = window->height + 2 * window->border;
+
+        if(!window->mapped || window->format == NULL)
+            continue;
+        if(window->x >= comp.width || window->y >= comp.height || window->x + width <= 0 || window->y + height <= 0)
+            continue;
+
+        if(window->picture == None)
+        {
+            window->pixmap = XCompositeNameWindowPixmap(wm.dpy, window->window);
+            window->picture = XRenderCreatePicture(wm.dpy, window->pixmap, window->format, 0, NULL);
+        }
+
+        XRenderComposite(wm.dpy, window->format->direct.alphaMask ? PictOpOver : PictOpSrc,
+                window->picture, None, comp.buffer, 0, 0, 0, 0, window->x, window->y, width, height);
+    }
+
+    XFixesSetPictureClipRegion(wm.dpy, comp.target, 0, 0, comp.damaged);
+    XRenderComposite(wm.dpy, PictOpSrc, comp.buffer, None, comp.target,
+            0, 0, 0, 0, 0, 0, comp.width, comp.height);
+
+    XFixesSetRegion(wm.dpy, comp.damaged, NULL, 0);
+    comp.dirty = false;
+
+    // Waits for the server to actually finish, that's the frame time
+    // and it also keeps us from queueing frames faster than they're drawn
+    XSync(wm.dpy, False);
+    ms = now_ms() - start;
+
+    ipc_event(IPC_EVENT_FRAME, "frame %.3f", ms);
+    comp.frames++;
+    comp.total_ms += ms;
+    if(ms > comp.max_ms)
+        comp.max_ms = ms;
+    if(comp.frames == STATS_FRAMES)
+    {
+        LOG("Compositor: %d frames, %.3fms avg, %.3fms max", comp.frames, comp.total_ms / comp.frames, comp.max_ms);
+        comp.frames = 0;
+        comp.total_ms = comp.max_ms = 0.0;
+    }
+}
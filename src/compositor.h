@@ -0,0 +1,24 @@
+#ifndef COMPOSITOR_H
+#define COMPOSITOR_H
+
+#include<X11/Xlib.h>
+#include<stdbool.h>
+
+// Optional built-in compositor, "compositor = 1" in the config
+// Everything runs through XRender, so it works on Xvfb/VNC boxes
+// without a GPU. Windows are redirected offscreen and XDamage tells
+// us which parts of them changed, only those parts get composited
+// onto the overlay window. Nothing happens at all while nothing is
+// damaged, and a fullscreen client is unredirected so it draws
+// straight to the screen
+
+bool compositor_init(void); // false if an extension is missing
+void compositor_deinit(void);
+bool compositor_active(void);
+
+// Sees every event before the WM does, returns true if it was
+// a compositor only event(XDamage) and needs no further handling
+bool compositor_event(XEvent *ev);
+void compositor_flush(void); // Composite damaged regions, once per main loop iteration
+
+#endif
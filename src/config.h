@@ -1,11 +1,53 @@
 #ifndef CONFIG_H
 #define CONFIG_H
 
+// Compiled-in defaults, the config file can override all of these
+// see config_file.h
+
 static int  border_width = 3;
 static long border_color = 0xFF0000;
+static long focus_border_color = 0x00FF00;
 static long background   = 0xa00a00;
 
 static int screen_width = 1920;
 static int screen_height = 1080;
 
+// Set bar_height to 0 to disable the bar
+static int  bar_height_px   = 18;
+static long bar_foreground = 0xeeeeee;
+static long bar_background = 0x222222;
+
+// 1 enables the built-in compositor, see compositor.h
+static int compositor = 0;
+
+// 1 focuses whatever the pointer enters(sloppy focus)
+static int focus_follows_mouse = 0;
+
+// NOTE: Keys must be pressed with modifier key(Left Alt)
+// Key name as understood by XStringToKeysym, "shift+" prefix for shift
+// Always the unshifted key, e.g. "shift+Tab" not "ISO_Left_Tab"
+// and the action, same as what's accepted over IPC
+static const char *bindings[][2] =
+{
+    { "t", "spawn /usr/bin/xterm" }, // Spawns xterm
+    { "q", "close" },
+    { "j", "focus next" },
+    { "k", "focus prev" },
+    { "Tab", "focus last" }, // Back and forth between the last two
+    { "i", "masters +1" }, // Increase master window count by 1
+    { "d", "masters -1" },
+    { "h", "weight -0.05" },
+    { "l", "weight +0.05" },
+    { "f", "fullscreen" },
+    { "m", "layout toggle" }, // Tile <-> monocle
+    { "x", "quit" },
+};
+
+// Applied to new windows, see rules.h
+static const char *rules[] =
+{
+    "role=pop-up floating",
+    "role=GtkFileChooserDialog floating",
+};
+
 #endif 
@@ -0,0 +1,390 @@
+#include<stdlib.h>
+#include<string.h>
+#include<strings.h>
+#include<fcntl.h>
+#include<unistd.h>
+#include<limits.h>
+#include<sys/mman.h>
+#include<sys/stat.h>
+#include<sys/inotify.h>
+
+#include "wm.h"
+#include "config.h"
+#include "config_file.h"
+#include "bar.h"
+#include "compositor.h"
+
+config_t config;
+
+static char path[PATH_MAX];
+static const char *file_name = NULL; // Points into path
+static int inotify_fd = -1;
+
+// Fills in everything from config.h
+static void config_defaults(config_t *cfg)
+{
+    memset(cfg, 0, sizeof(config_t));
+    cfg->border_width = border_width;
+    cfg->border_color = border_color;
+    cfg->focus_border_color = focus_border_color;
+    cfg->background = background;
+    cfg->screen_width = screen_width;
+    cfg->screen_height = screen_height;
+    cfg->bar_height = bar_height_px;
+    cfg->bar_foreground = bar_foreground;
+    cfg->bar_background = bar_background;
+    cfg->compositor = compositor;
+    cfg->focus_follows_mouse = focus_follows_mouse;
+    rules_clear(&cfg->rules);
+}
+
+// "shift+Return spawn xterm" -> binding, added or replacing one for the same key
+static const char* add_binding(config_t *cfg, const char *value)
+{
+    char key[64];
+    size_t len = strcspn(value, " \t");
+    binding_t binding = {0};
+    const char *error = NULL;
+    KeySym upper = NoSymbol;
+
+    if(len == 0 || len >= sizeof(key))
+        return "bind expects a key";
+    memcpy(key, value, len);
+    key[len] = '\0';
+
+    if(strncasecmp(key, "shift+", 6) == 0)
+    {
+        binding.modifiers = ShiftMask;
+        memmove(key, key + 6, len - 6 + 1);
+    }
+
+    binding.keysym = XStringToKeysym(key);
+    if(binding.keysym == NoSymbol)
+        return "unknown key";
+    // Key presses are looked up unshifted, see handle_key_press()
+    // so "shift+H" is the same as "shift+h"
+    XConvertCase(binding.keysym, &binding.keysym, &upper);
+
+    error = action_parse(value + len, &binding.action);
+    if(error != NULL)
+        return error;
+
+    for(int i = 0; i < cfg->bindings_len; i++)
+    {
+        if(cfg->bindings[i].keysym == binding.keysym && cfg->bindings[i].modifiers == binding.modifiers)
+        {
+            cfg->bindings[i] = binding;
+            return NULL;
+        }
+    }
+
+    if(cfg->bindings_len == CONFIG_MAX_BINDINGS)
+        return "too many bindings";
+    cfg->bindings[cfg->bindings_len++] = binding;
+    return NULL;
+}
+
+static const char* set_int(const char *value, int *out)
+{
+    char *end = NULL;
+    long number = strtol(value, &end, 0);
+
+    if(end == value || number < 0)
+        return "expected a positive number";
+    *out = number;
+    return NULL;
+}
+
+// #rrggbb or anything strtol understands
+static const char* set_color(const char *value, long *out)
+{
+    const char *digits = value[0] == '#' ? value + 1 : value;
+    char *end = NULL;
+    long color = strtol(digits, &end, value[0] == '#' ? 16 : 0);
+
+    if(end == digits || color < 0 || color > 0xFFFFFF)
+        return "expected a color";
+    *out = color;
+    return NULL;
+}
+
+static const char* set_option(config_t *cfg, const char *key, const char *value)
+{
+    if(strcmp(key, "border_width") == 0)
+        return set_int(value, &cfg->border_width);
+    else if(strcmp(key, "border_color") == 0)
+        return set_color(value, &cfg->border_color);
+    else if(strcmp(key, "focus_border_color") == 0)
+        return set_color(value, &cfg->focus_border_color);
+    else if(strcmp(key, "background") == 0)
+        return set_color(value, &cfg->background);
+    else if(strcmp(key, "screen_width") == 0)
+        return set_int(value, &cfg->screen_width);
+    else if(strcmp(key, "screen_height") == 0)
+        return set_int(value, &cfg->screen_height);
+    else if(strcmp(key, "bar_height") == 0)
+        return set_int(value, &cfg->bar_height);
+    else if(strcmp(key, "bar_foreground") == 0)
+        return set_color(value, &cfg->bar_foreground);
+    else if(strcmp(key, "bar_background") == 0)
+        return set_color(value, &cfg->bar_background);
+    else if(strcmp(key, "compositor") == 0)
+        return set_int(value, &cfg->compositor);
+    else if(strcmp(key, "focus_follows_mouse") == 0)
+        return set_int(value, &cfg->focus_follows_mouse);
+    else if(strcmp(key, "bind") == 0)
+        return add_binding(cfg, value);
+    else if(strcmp(key, "rule") == 0)
+        return rules_add(&cfg->rules, value);
+
+    return "unknown setting";
+}
+
+// Single pass over the whole mapped file, lines are never copied
+// only the key and value get copied into small buffers
+static void parse(config_t *cfg, const char *data, size_t size)
+{
+    const char *end = data + size, *line = data;
+    char key[64], value[512];
+    int line_number = 0;
+
+    while(line < end)
+    {
+        const char *eol = memchr(line, '\n', end - line);
+        const char *p = line, *key_end = NULL, *value_begin = NULL, *value_end = NULL;
+        const char *error = NULL;
+
+        if(eol == NULL)
+            eol = end;
+        value_end = eol;
+        line_number++;
+
+        // Empty lines and comments, colors also use # so
+        // comments are only allowed on their own line
+        while(p < value_end && (*p == ' ' || *p == '\t'))
+            p++;
+        if(p == value_end || *p == '\r' || *p == '#')
+        {
+            line = eol + 1;
+            continue;
+        }
+
+        key_end = memchr(p, '=', value_end - p);
+        if(key_end == NULL)
+        {
+            LOG("config %s:%d: expected key = value", path, line_number);
+            line = eol + 1;
+            continue;
+        }
+        value_begin = key_end + 1;
+
+        while(key_end > p && (key_end[-1] == ' ' || key_end[-1] == '\t'))
+            key_end--;
+        while(value_begin < value_end && (*value_begin == ' ' || *value_begin == '\t'))
+            value_begin++;
+        while(value_end > value_begin && (value_end[-1] == ' ' || value_end[-1] == '\t' || value_end[-1] == '\r'))
+            value_end--;
+
+        if((size_t)(key_end - p) >= sizeof(key) || (size_t)(value_end - value_begin) >= sizeof(value))
+            error = "line too long";
+        else
+        {
+            memcpy(key, p, key_end - p);
+            key[key_end - p] = '\0';
+            memcpy(value, value_begin, value_end - value_begin);
+            value[value_end - value_begin] = '\0';
+            error = set_option(cfg, key, value);
+        }
+
+        if(error != NULL)
+        {
+            LOG("config %s:%d: %s", path, line_number, error);
+        }
+        line = eol + 1;
+    }
+}
+
+static void load(config_t *cfg)
+{
+    struct stat info;
+    void *data = NULL;
+    int fd = -1;
+
+    config_defaults(cfg);
+    for(size_t i = 0; i < sizeof(bindings)/sizeof(bindings[0]); i++)
+    {
+        char line[512];
+        snprintf(line, sizeof(line), "%s %s", bindings[i][0], bindings[i][1]);
+        const char *error = add_binding(cfg, line);
+        if(error != NULL)
+        {
+            LOG("config.h binding \"%s\": %s", line, error);
+        }
+    }
+    for(size_t i = 0; i < sizeof(rules)/sizeof(rules[0]); i++)
+    {
+        const char *error = rules_add(&cfg->rules, rules[i]);
+        if(error != NULL)
+        {
+            LOG("config.h rule \"%s\": %s", rules[i], error);
+        }
+    }
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if(fd < 0)
+        return; // No config file is fine, defaults it is
+
+    if(fstat(fd, &info) == 0 && info.st_size > 0)
+    {
+        data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(data != MAP_FAILED)
+        {
+            parse(cfg, data, info.st_size);
+            munmap(data, info.st_size);
+        }
+    }
+    close(fd);
+}
+
+// Only touches what's different between old and the current config
+static void apply(const config_t *old)
+{
+    bool retile = false;
+
+    if(old->border_color != config.border_color)
+        for(client_t *client = wm.head; client != NULL; client = client->next)
+            if(client != wm.focus)
+                XSetWindowBorder(wm.dpy, client->frame, config.border_color);
+    if(old->focus_border_color != config.focus_border_color && wm.focus != NULL)
+        XSetWindowBorder(wm.dpy, wm.focus->frame, config.focus_border_color);
+
+    if(old->background != config.background)
+    {
+        for(client_t *client = wm.head; client != NULL; client = client->next)
+        {
+            XSetWindowBackground(wm.dpy, client->frame, config.background);
+            XClearWindow(wm.dpy, client->frame);
+        }
+    }
+
+    if(old->border_width != config.border_width)
+    {
+        for(client_t *client = wm.head; client != NULL; client = client->next)
+            if(!client->fullscreen)
+                XSetWindowBorderWidth(wm.dpy, client->frame, config.border_width);
+        retile = true;
+    }
+
+    if(old->bar_height != config.bar_height || old->screen_width != config.screen_width)
+    {
+        bar_deinit();
+        bar_init(config.screen_width, config.bar_height, config.bar_foreground, config.bar_background);
+        bar_set_title(wm.focus != NULL ? wm.focus->window : None);
+        retile = true;
+    }
+    else if(old->bar_foreground != config.bar_foreground || old->bar_background != config.bar_background)
+        bar_set_colors(config.bar_foreground, config.bar_background);
+
+    if(old->screen_height != config.screen_height)
+        retile = true;
+
+    if(old->compositor != config.compositor)
+    {
+        if(config.compositor)
+            compositor_init();
+        else
+            compositor_deinit();
+    }
+
+    if(old->focus_follows_mouse != config.focus_follows_mouse)
+        for(client_t *client = wm.head; client != NULL; client = client->next)
+            XSelectInput(wm.dpy, client->frame, frame_event_mask());
+
+    if(retile)
+        arrange();
+}
+
+void config_init(void)
+{
+    const char *env = getenv("TILE_WM_CONFIG");
+    const char *config_home = getenv("XDG_CONFIG_HOME");
+    const char *home = getenv("HOME");
+    char dir[PATH_MAX];
+
+    if(env != NULL)
+        snprintf(path, sizeof(path), "%s", env);
+    else if(config_home != NULL)
+        snprintf(path, sizeof(path), "%s/tile_wm/config", config_home);
+    else
+        snprintf(path, sizeof(path), "%s/.config/tile_wm/config", home != NULL ? home : ".");
+
+    load(&config);
+
+    // Watch the directory rather than the file, editors
+    // tend to save by writing a new file and renaming it
+    file_name = strrchr(path, '/');
+    file_name = file_name != NULL ? file_name + 1 : path;
+    snprintf(dir, sizeof(dir), "%.*s", (int)(file_name - path), path);
+    if(dir[0] == '\0')
+        strcpy(dir, ".");
+
+    inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if(inotify_fd >= 0 && inotify_add_watch(inotify_fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE) < 0)
+    {
+        close(inotify_fd);
+        inotify_fd = -1;
+    }
+
+    LOG("Config: %s%s", path, inotify_fd >= 0 ? "" : " (not watched)");
+}
+
+void config_deinit(void)
+{
+    if(inotify_fd >= 0)
+        close(inotify_fd);
+    inotify_fd = -1;
+}
+
+int config_fd(void)
+{
+    return inotify_fd;
+}
+
+// Several events usually come in for one save, they're all read
+// here so it only gets reloaded once
+bool config_changed(void)
+{
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    bool changed = false;
+    ssize_t len = 0;
+
+    while((len = read(inotify_fd, buffer, sizeof(buffer))) > 0)
+    {
+        for(char *p = buffer; p < buffer + len; )
+        {
+            struct inotify_event *event = (struct inotify_event*)p;
+            if(event->len > 0 && strcmp(event->name, file_name) == 0)
+                changed = true;
+            p += sizeof(struct inotify_event) + event->len;
+        }
+    }
+
+    return changed;
+}
+
+void config_reload(void)
+{
+    config_t old = config;
+    load(&config);
+    apply(&old);
+    LOG("Config reloaded");
+}
+
+const binding_t* config_binding(KeySym keysym, unsigned int state)
+{
+    for(int i = 0; i < config.bindings_len; i++)
+        if(config.bindings[i].keysym == keysym && config.bindings[i].modifiers == (state & ShiftMask))
+            return &config.bindings[i];
+
+    return NULL;
+}
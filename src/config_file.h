@@ -0,0 +1,58 @@
+#ifndef CONFIG_FILE_H
+#define CONFIG_FILE_H
+
+#include<X11/Xlib.h>
+#include<stdbool.h>
+
+#include "action.h"
+#include "rules.h"
+
+// Runtime configuration
+// Starts out with the compiled-in values from config.h, then the config
+// file is read on top of them. The file is watched with inotify and
+// on change only the parts that actually changed are reapplied
+//
+// Format, one setting per line, lines starting with # are comments:
+//   border_color = #ff0000
+//   bind = shift+Return spawn xterm
+//   rule = class=mpv fullscreen, see rules.h
+
+#define CONFIG_MAX_BINDINGS 64
+
+typedef struct
+{
+    KeySym keysym;
+    unsigned int modifiers; // On top of Mod1, only ShiftMask for now
+    action_t action;
+} binding_t;
+
+typedef struct
+{
+    int border_width;
+    long border_color, focus_border_color;
+    long background;
+
+    int screen_width, screen_height;
+
+    int bar_height; // 0 disables the bar
+    long bar_foreground, bar_background;
+
+    int compositor; // 0 or 1
+    int focus_follows_mouse; // 0 or 1
+
+    binding_t bindings[CONFIG_MAX_BINDINGS];
+    int bindings_len;
+
+    ruleset_t rules;
+} config_t;
+extern config_t config;
+
+void config_init(void); // Defaults + config file
+void config_deinit(void);
+int config_fd(void);    // inotify fd for poll(), -1 if not watching
+bool config_changed(void); // Call when config_fd() is readable, doesn't touch X so any thread can
+void config_reload(void);  // X thread
+
+const binding_t* config_binding(KeySym keysym, unsigned int state);
+
+#endif
@@ -0,0 +1,229 @@
+#include<stdlib.h>
+#include<string.h>
+#include<X11/Xatom.h>
+
+#include "wm.h"
+#include "ewmh.h"
+
+Atom net_atoms[NET_ATOMS];
+
+// Order matches enum ewmh_atom_t
+static char *atom_names[NET_ATOMS] =
+{
+    "_NET_SUPPORTED",
+    "_NET_SUPPORTING_WM_CHECK",
+    "_NET_WM_NAME",
+    "_NET_CLIENT_LIST",
+    "_NET_ACTIVE_WINDOW",
+    "_NET_NUMBER_OF_DESKTOPS",
+    "_NET_CURRENT_DESKTOP",
+    "_NET_WM_DESKTOP",
+    "_NET_CLOSE_WINDOW",
+    "_NET_WM_STATE",
+    "_NET_WM_STATE_DEMANDS_ATTENTION",
+    "_NET_WM_STATE_FULLSCREEN",
+    "_NET_WM_SYNC_REQUEST",
+    "_NET_WM_SYNC_REQUEST_COUNTER",
+    "UTF8_STRING",
+};
+
+// Bit i of client_t.net_state is state_atoms[i]
+static enum ewmh_atom_t state_atoms[] =
+{
+    NET_WM_STATE_DEMANDS_ATTENTION,
+    NET_WM_STATE_FULLSCREEN,
+};
+#define STATES (int)(sizeof(state_atoms)/sizeof(state_atoms[0]))
+
+// What _NET_CLIENT_LIST currently holds on the server, mapping order
+// Kept so removals can rewrite the property without reading it back
+typedef struct
+{
+    Window *windows;
+    int len, capacity;
+} client_list_t;
+
+static client_list_t client_list;
+static Window check_window = None;
+static Window active = (Window)-1; // Last value written to _NET_ACTIVE_WINDOW
+
+static void set_cardinal(Window window, enum ewmh_atom_t atom, long value)
+{
+    XChangeProperty(wm.dpy, window, net_atoms[atom], XA_CARDINAL, 32,
+            PropModeReplace, (unsigned char*)&value, 1);
+}
+
+void ewmh_init(void)
+{
+    const char *name = "tile_wm";
+
+    XInternAtoms(wm.dpy, atom_names, NET_ATOMS, False, net_atoms);
+
+    // Tells clients an EWMH compliant WM is running
+    check_window = XCreateSimpleWindow(wm.dpy, wm.root, -1, -1, 1, 1, 0, 0, 0);
+    XChangeProperty(wm.dpy, wm.root, net_atoms[NET_SUPPORTING_WM_CHECK], XA_WINDOW, 32,
+            PropModeReplace, (unsigned char*)&check_window, 1);
+    XChangeProperty(wm.dpy, check_window, net_atoms[NET_SUPPORTING_WM_CHECK], XA_WINDOW, 32,
+            PropModeReplace, (unsigned char*)&check_window, 1);
+    XChangeProperty(wm.dpy, check_window, net_atoms[NET_WM_NAME], net_atoms[UTF8_STRING], 8,
+            PropModeReplace, (unsigned char*)name, strlen(name));
+
+    // Everything but UTF8_STRING is something we support
+    XChangeProperty(wm.dpy, wm.root, net_atoms[NET_SUPPORTED], XA_ATOM, 32,
+            PropModeReplace, (unsigned char*)net_atoms, NET_ATOMS - 1);
+
+    // NOTE: No workspaces yet, so there's only ever one desktop
+    set_cardinal(wm.root, NET_NUMBER_OF_DESKTOPS, 1);
+    set_cardinal(wm.root, NET_CURRENT_DESKTOP, 0);
+
+    XChangeProperty(wm.dpy, wm.root, net_atoms[NET_CLIENT_LIST], XA_WINDOW, 32,
+            PropModeReplace, NULL, 0);
+    ewmh_set_active(NULL);
+}
+
+void ewmh_deinit(void)
+{
+    if(check_window == None)
+        return;
+
+    XDeleteProperty(wm.dpy, wm.root, net_atoms[NET_SUPPORTING_WM_CHECK]);
+    XDeleteProperty(wm.dpy, wm.root, net_atoms[NET_CLIENT_LIST]);
+    XDeleteProperty(wm.dpy, wm.root, net_atoms[NET_ACTIVE_WINDOW]);
+    XDestroyWindow(wm.dpy, check_window);
+    check_window = None;
+
+    free(client_list.windows);
+    memset(&client_list, 0, sizeof(client_list));
+}
+
+void ewmh_client_add(client_t *client)
+{
+    if(client_list.len == client_list.capacity)
+    {
+        int capacity = client_list.capacity == 0 ? 16 : client_list.capacity * 2;
+        Window *windows = realloc(client_list.windows, capacity * sizeof(Window));
+        if(windows == NULL)
+            return;
+        client_list.windows = windows;
+        client_list.capacity = capacity;
+    }
+    client_list.windows[client_list.len++] = client->window;
+
+    // Only the new window goes over the wire
+    XChangeProperty(wm.dpy, wm.root, net_atoms[NET_CLIENT_LIST], XA_WINDOW, 32,
+            PropModeAppend, (unsigned char*)&client->window, 1);
+    set_cardinal(client->window, NET_WM_DESKTOP, 0);
+}
+
+void ewmh_client_remove(client_t *client)
+{
+    for(int i = 0; i < client_list.len; i++)
+    {
+        if(client_list.windows[i] != client->window)
+            continue;
+
+        memmove(&client_list.windows[i], &client_list.windows[i+1],
+                (client_list.len - i - 1) * sizeof(Window));
+        client_list.len--;
+        ewmh_client_list_rewrite();
+        break;
+    }
+
+    if(active == client->window)
+        ewmh_set_active(NULL);
+}
+
+void ewmh_client_list_rewrite(void)
+{
+    XChangeProperty(wm.dpy, wm.root, net_atoms[NET_CLIENT_LIST], XA_WINDOW, 32,
+            PropModeReplace, (unsigned char*)client_list.windows, client_list.len);
+}
+
+void ewmh_set_active(client_t *client)
+{
+    Window window = client != NULL ? client->window : None;
+
+    if(window == active)
+        return;
+    active = window;
+
+    XChangeProperty(wm.dpy, wm.root, net_atoms[NET_ACTIVE_WINDOW], XA_WINDOW, 32,
+            PropModeReplace, (unsigned char*)&window, 1);
+
+    // Whatever wanted attention now has it
+    if(client != NULL && client->net_state & EWMH_STATE_DEMANDS_ATTENTION)
+        ewmh_set_state(client, client->net_state & ~EWMH_STATE_DEMANDS_ATTENTION);
+}
+
+void ewmh_set_state(client_t *client, unsigned int state)
+{
+    Atom atoms[STATES];
+    int len = 0;
+
+    if(client->net_state == state)
+        return;
+    client->net_state = state;
+
+    for(int i = 0; i < STATES; i++)
+        if(state & (1u << i))
+            atoms[len++] = net_atoms[state_atoms[i]];
+
+    XChangeProperty(wm.dpy, client->window, net_atoms[NET_WM_STATE], XA_ATOM, 32,
+            PropModeReplace, (unsigned char*)atoms, len);
+}
+
+unsigned int ewmh_state_from_atom(Atom atom)
+{
+    for(int i = 0; i < STATES; i++)
+        if(atom == net_atoms[state_atoms[i]])
+            return 1u << i;
+    return 0;
+}
+
+// _NET_WM_STATE data.l[0]
+#define NET_WM_STATE_REMOVE 0
+#define NET_WM_STATE_ADD    1
+#define NET_WM_STATE_TOGGLE 2
+
+static unsigned int state_request(unsigned int state, long action, Atom atom)
+{
+    for(int i = 0; i < STATES; i++)
+    {
+        if(atom == None || atom != net_atoms[state_atoms[i]])
+            continue;
+
+        if(action == NET_WM_STATE_REMOVE)
+            state &= ~(1u << i);
+        else if(action == NET_WM_STATE_ADD)
+            state |= 1u << i;
+        else if(action == NET_WM_STATE_TOGGLE)
+            state ^= 1u << i;
+    }
+
+    return state;
+}
+
+void ewmh_client_message(XClientMessageEvent *event)
+{
+    client_t *client = client_from_window(event->window, NULL);
+    unsigned int state = 0;
+
+    if(client == NULL)
+        return;
+
+    if(event->message_type == net_atoms[NET_ACTIVE_WINDOW])
+        focus_client(client);
+    else if(event->message_type == net_atoms[NET_CLOSE_WINDOW])
+        close_client(client);
+    else if(event->message_type == net_atoms[NET_WM_STATE])
+    {
+        // Up to two states can be changed by one message
+        state = state_request(client->net_state, event->data.l[0], event->data.l[1]);
+        state = state_request(state, event->data.l[0], event->data.l[2]);
+
+        // Fullscreen does more than just flip the property
+        if((state ^ client->net_state) & EWMH_STATE_FULLSCREEN)
+            set_fullscreen(client, state & EWMH_STATE_FULLSCREEN);
+        ewmh_set_state(client, state);
+    }
+}
@@ -0,0 +1,54 @@
+#ifndef EWMH_H
+#define EWMH_H
+
+#include<X11/Xlib.h>
+#include<stdbool.h>
+
+#include "wm.h"
+
+// Extended window manager hints, what pagers, bars and apps look at
+// Root properties are kept up to date incrementally, e.g. a new client
+// is appended to _NET_CLIENT_LIST instead of rewriting the whole list,
+// and nothing is written if the value didn't change
+
+enum ewmh_atom_t
+{
+    NET_SUPPORTED = 0,
+    NET_SUPPORTING_WM_CHECK,
+    NET_WM_NAME,
+    NET_CLIENT_LIST,
+    NET_ACTIVE_WINDOW,
+    NET_NUMBER_OF_DESKTOPS,
+    NET_CURRENT_DESKTOP,
+    NET_WM_DESKTOP,
+    NET_CLOSE_WINDOW,
+    NET_WM_STATE,
+    NET_WM_STATE_DEMANDS_ATTENTION,
+    NET_WM_STATE_FULLSCREEN,
+    NET_WM_SYNC_REQUEST,
+    NET_WM_SYNC_REQUEST_COUNTER,
+    UTF8_STRING,
+    NET_ATOMS
+};
+extern Atom net_atoms[NET_ATOMS];
+
+// Bits for client_t.net_state, in the same order as the atoms
+enum ewmh_state_t
+{
+    EWMH_STATE_DEMANDS_ATTENTION = 1 << 0,
+    EWMH_STATE_FULLSCREEN        = 1 << 1,
+};
+
+void ewmh_init(void);
+void ewmh_deinit(void);
+
+void ewmh_client_add(client_t *client);
+void ewmh_client_remove(client_t *client);
+void ewmh_client_list_rewrite(void); // After the stack was reordered
+void ewmh_set_active(client_t *client);
+void ewmh_set_state(client_t *client, unsigned int state);
+unsigned int ewmh_state_from_atom(Atom atom); // ewmh_state_t bit, 0 if it's not one we know
+
+void ewmh_client_message(XClientMessageEvent *event);
+
+#endif
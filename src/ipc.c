@@ -0,0 +1,655 @@
+#define _GNU_SOURCE // accept4
+#include<stdarg.h>
+#include<string.h>
+#include<errno.h>
+#include<unistd.h>
+#include<poll.h>
+#include<pthread.h>
+#include<sys/socket.h>
+#include<sys/un.h>
+#include<sys/stat.h>
+#include<sys/eventfd.h>
+
+#include "wm.h"
+#include "ipc.h"
+#include "action.h"
+#include "config_file.h"
+#include "spsc.h"
+
+// All of the non-X I/O(the socket, every client and the config file
+// watch) runs on its own thread, so a slow or misbehaving client can
+// never hold up X events. The two threads only talk through two
+// lock-free queues and wake each other up with an eventfd:
+//   requests: io thread -> X thread, parsed commands and queries
+//   replies:  X thread -> io thread, query replies and events
+//
+// NOTE: Xlib is only ever touched by the X thread, the io thread
+// doesn't know about the display at all
+
+#define IPC_QUEUE_SIZE 256 // Slots per queue, power of 2
+#define IPC_BATCH 64       // Requests handled per ipc_dispatch() call
+
+enum request_type_t
+{
+    REQUEST_COMMAND = 0, // action, only replied to if client is set
+    REQUEST_GET_CLIENTS,
+    REQUEST_GET_LAYOUT,
+    REQUEST_CONFIG,      // Config file changed
+};
+
+typedef struct
+{
+    uint32_t type; // request_type_t
+    int client;    // Slot in ipc_clients, -1 if no reply is wanted
+    uint32_t generation; // Slot might be reused by the time the reply is back
+    action_t action;
+} request_t;
+
+typedef struct
+{
+    uint32_t type; // ipc_message_t, or IPC_EVENT | event for events
+    int client;    // -1 for events, they go to every subscriber
+    uint32_t generation;
+    uint32_t len;
+    char payload[IPC_MAX_PAYLOAD];
+} reply_t;
+
+// Every connection to the socket is an ipc client
+// Only the io thread touches these
+// Nothing here ever blocks, reads and writes are buffered
+// and picked up again when poll says the socket is ready
+typedef struct
+{
+    int fd; // -1 if the slot is free
+    uint32_t generation;
+    uint32_t events; // Subscribed events mask
+
+    char in[sizeof(ipc_header_t) + IPC_MAX_PAYLOAD];
+    size_t in_len;
+
+    char *out; // IPC_OUT_BUFFER bytes
+    size_t out_len;
+} ipc_client_t;
+
+static int listen_fd = -1;
+static struct sockaddr_un address;
+static ipc_client_t ipc_clients[IPC_MAX_CLIENTS];
+// Union of every client's events, skips formatting unwanted events
+// Written by the io thread, read by the X thread
+static uint32_t subscribed;
+
+static spsc_t requests, replies;
+static int x_wake = -1, io_wake = -1; // eventfds, the thread which gets woken up polls it
+static pthread_t io_thread;
+static bool io_running = false, io_stop = false;
+static bool replies_pushed = false; // X thread only, see ipc_flush()
+static bool replies_full = false;   // X thread only, logs once per overflow
+
+static void update_subscribed(void)
+{
+    uint32_t events = 0;
+    for(int i = 0; i < IPC_MAX_CLIENTS; i++)
+        if(ipc_clients[i].fd != -1)
+            events |= ipc_clients[i].events;
+    __atomic_store_n(&subscribed, events, __ATOMIC_RELAXED);
+}
+
+static void wake(int fd)
+{
+    uint64_t one = 1;
+    if(write(fd, &one, sizeof(one)) < 0)
+        return; // Only fails if the counter is about to overflow, it's awake anyway
+}
+
+static void client_drop(ipc_client_t *client)
+{
+    uint32_t generation = client->generation;
+
+    close(client->fd);
+    free(client->out);
+    memset(client, 0, sizeof(ipc_client_t));
+    client->fd = -1;
+    client->generation = generation + 1;
+
+    update_subscribed();
+}
+
+// Only queues the message, client_flush() does the actual writing
+static void client_send(ipc_client_t *client, uint32_t type, const char *payload, size_t len)
+{
+    ipc_header_t header = { .length = len, .type = type };
+
+    // Running a command sends events, that can drop the client
+    // that sent it before its reply gets here
+    if(client->fd == -1)
+        return;
+
+    if(client->out_len + sizeof(header) + len > IPC_OUT_BUFFER)
+    {
+        LOG("IPC client %d is not keeping up, dropping it", client->fd);
+        client_drop(client);
+        return;
+    }
+
+    memcpy(client->out + client->out_len, &header, sizeof(header));
+    memcpy(client->out + client->out_len + sizeof(header), payload, len);
+    client->out_len += sizeof(header) + len;
+}
+
+static void client_flush(ipc_client_t *client)
+{
+    ssize_t sent = send(client->fd, client->out, client->out_len, MSG_DONTWAIT | MSG_NOSIGNAL);
+
+    if(sent < 0)
+    {
+        if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+            client_drop(client);
+        return;
+    }
+
+    memmove(client->out, client->out + sent, client->out_len - sent);
+    client->out_len -= sent;
+}
+
+static uint32_t parse_events(const char *string)
+{
+    uint32_t events = 0;
+
+    if(strstr(string, "focus") != NULL)
+        events |= IPC_EVENT_FOCUS;
+    if(strstr(string, "layout") != NULL)
+        events |= IPC_EVENT_LAYOUT;
+    if(strstr(string, "map") != NULL)
+        events |= IPC_EVENT_MAP;
+    if(strstr(string, "frame") != NULL)
+        events |= IPC_EVENT_FRAME;
+    if(strstr(string, "stack") != NULL)
+        events |= IPC_EVENT_STACK;
+
+    return events;
+}
+
+// io thread, returns false if the X thread is too far behind
+static bool push_request(uint32_t type, ipc_client_t *client, const action_t *action)
+{
+    request_t *request = spsc_reserve(&requests);
+
+    if(request == NULL)
+        return false;
+
+    request->type = type;
+    request->client = client != NULL ? (int)(client - ipc_clients) : -1;
+    request->generation = client != NULL ? client->generation : 0;
+    if(action != NULL)
+        request->action = *action;
+    spsc_push(&requests);
+    return true;
+}
+
+// io thread, parsing and subscriptions don't need the X thread at all
+// Returns true if something was queued for the X thread
+static bool handle_message(ipc_client_t *client, uint32_t type, char *payload)
+{
+    char reply[IPC_MAX_PAYLOAD];
+    size_t len = 0;
+    const char *error = NULL;
+    action_t action;
+
+    switch(type)
+    {
+        case IPC_COMMAND:
+            // Answered right away, commands don't return anything
+            // except for "focus <window>", only the X thread knows the windows
+            error = action_parse(payload, &action);
+            if(error == NULL && action.type == ACTION_FOCUS_WINDOW)
+            {
+                if(push_request(REQUEST_COMMAND, client, &action))
+                    return true;
+                error = "busy";
+            }
+            else if(error == NULL && !push_request(REQUEST_COMMAND, NULL, &action))
+                error = "busy";
+            len = snprintf(reply, sizeof(reply), "%s", error == NULL ? "ok" : error);
+            break;
+        case IPC_GET_CLIENTS:
+        case IPC_GET_LAYOUT:
+            // The X thread replies
+            if(push_request(type == IPC_GET_CLIENTS ? REQUEST_GET_CLIENTS : REQUEST_GET_LAYOUT, client, NULL))
+                return true;
+            len = snprintf(reply, sizeof(reply), "busy");
+            break;
+        case IPC_SUBSCRIBE:
+            client->events = parse_events(payload);
+            update_subscribed();
+            len = snprintf(reply, sizeof(reply), "%s", client->events != 0 ? "ok" : "no known events");
+            break;
+        default:
+            len = snprintf(reply, sizeof(reply), "unknown message type");
+            break;
+    }
+
+    client_send(client, type, reply, len);
+    return type == IPC_COMMAND && error == NULL;
+}
+
+// Returns true if something was queued for the X thread
+static bool client_read(ipc_client_t *client)
+{
+    ssize_t received = 0;
+    ipc_header_t header;
+    size_t message_len = 0;
+    bool queued = false;
+
+    received = recv(client->fd, client->in + client->in_len, sizeof(client->in) - client->in_len, MSG_DONTWAIT);
+    if(received == 0 || (received < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+    {
+        client_drop(client);
+        return false;
+    }
+    else if(received < 0)
+        return false;
+    client->in_len += received;
+
+    // Handle every complete message in the buffer
+    while(client->fd != -1 && client->in_len >= sizeof(header))
+    {
+        memcpy(&header, client->in, sizeof(header));
+        if(header.length > IPC_MAX_PAYLOAD)
+        {
+            LOG("IPC message too large, dropping client %d", client->fd);
+            client_drop(client);
+            return queued;
+        }
+
+        message_len = sizeof(header) + header.length;
+        if(client->in_len < message_len)
+            break;
+
+        // Payload is text, NULL terminate it in a copy so
+        // the parsing doesn't need to care about the length
+        char payload[IPC_MAX_PAYLOAD + 1];
+        memcpy(payload, client->in + sizeof(header), header.length);
+        payload[header.length] = '\0';
+
+        memmove(client->in, client->in + message_len, client->in_len - message_len);
+        client->in_len -= message_len;
+
+        queued |= handle_message(client, header.type, payload);
+    }
+
+    return queued;
+}
+
+static void accept_clients(void)
+{
+    int fd = -1;
+
+    while((fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0)
+    {
+        ipc_client_t *client = NULL;
+        for(int i = 0; i < IPC_MAX_CLIENTS && client == NULL; i++)
+            if(ipc_clients[i].fd == -1)
+                client = &ipc_clients[i];
+
+        if(client == NULL)
+        {
+            LOG("Too many IPC clients");
+            close(fd);
+            continue;
+        }
+
+        client->out = malloc(IPC_OUT_BUFFER);
+        if(client->out == NULL)
+        {
+            close(fd);
+            continue;
+        }
+        client->fd = fd;
+        client->generation++;
+        client->events = 0;
+        client->in_len = 0;
+        client->out_len = 0;
+    }
+}
+
+// io thread, hands replies and events from the X thread to the clients
+static void drain_replies(void)
+{
+    reply_t *reply = NULL;
+
+    while((reply = spsc_peek(&replies)) != NULL)
+    {
+        if(reply->client >= 0)
+        {
+            ipc_client_t *client = &ipc_clients[reply->client];
+            // Client might have gone away in the meantime
+            if(client->fd != -1 && client->generation == reply->generation)
+                client_send(client, reply->type, reply->payload, reply->len);
+        }
+        else
+        {
+            for(int i = 0; i < IPC_MAX_CLIENTS; i++)
+                if(ipc_clients[i].fd != -1 && (ipc_clients[i].events & reply->type))
+                    client_send(&ipc_clients[i], reply->type, reply->payload, reply->len);
+        }
+        spsc_pop(&replies);
+    }
+}
+
+static void* io_main(void *arg)
+{
+    struct pollfd fds[IPC_MAX_CLIENTS + 3];
+    ipc_client_t *polled[IPC_MAX_CLIENTS + 3];
+    uint64_t count = 0;
+    (void)arg;
+
+    while(!__atomic_load_n(&io_stop, __ATOMIC_ACQUIRE))
+    {
+        bool queued = false;
+        int len = 0;
+
+        // poll() skips the negative ones
+        fds[len++] = (struct pollfd){ .fd = io_wake, .events = POLLIN };
+        fds[len++] = (struct pollfd){ .fd = config_fd(), .events = POLLIN };
+        fds[len++] = (struct pollfd){ .fd = listen_fd, .events = POLLIN };
+
+        for(int i = 0; i < IPC_MAX_CLIENTS; i++)
+        {
+            ipc_client_t *client = &ipc_clients[i];
+            if(client->fd == -1)
+                continue;
+
+            // Queued replies and events are written once per loop iteration
+            if(client->out_len > 0)
+                client_flush(client);
+            if(client->fd == -1)
+                continue;
+
+            polled[len] = client;
+            fds[len++] = (struct pollfd){
+                .fd = client->fd,
+                .events = POLLIN | (client->out_len > 0 ? POLLOUT : 0)
+            };
+        }
+
+        if(poll(fds, len, -1) < 0)
+            continue; // EINTR
+
+        if(fds[0].revents & POLLIN)
+        {
+            if(read(io_wake, &count, sizeof(count)) < 0)
+                count = 0;
+            drain_replies();
+        }
+
+        // The file is parsed by the X thread, XStringToKeysym isn't ours to call
+        if(fds[1].revents & POLLIN && config_changed())
+            queued |= push_request(REQUEST_CONFIG, NULL, NULL);
+
+        if(fds[2].revents & POLLIN)
+            accept_clients();
+
+        for(int i = 3; i < len; i++)
+        {
+            ipc_client_t *client = polled[i];
+            if(fds[i].revents == 0 || client->fd != fds[i].fd)
+                continue;
+
+            if(fds[i].revents & (POLLIN | POLLHUP | POLLERR))
+                queued |= client_read(client);
+            if(client->fd != -1 && fds[i].revents & POLLOUT)
+                client_flush(client);
+        }
+
+        // One wake up for everything read this time around
+        if(queued)
+            wake(x_wake);
+    }
+
+    return NULL;
+}
+
+// Left over from a previous session that crashed, nothing answers on it
+// A live one is some other running WM's, that one isn't taken over
+static bool socket_stale(const char *path)
+{
+    struct sockaddr_un other = { .sun_family = AF_UNIX };
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    bool stale = false;
+
+    if(fd < 0)
+        return false;
+    snprintf(other.sun_path, sizeof(other.sun_path), "%s", path);
+    stale = connect(fd, (struct sockaddr*)&other, sizeof(other)) < 0 && errno == ECONNREFUSED;
+    close(fd);
+    return stale;
+}
+
+static void listen_socket(void)
+{
+    address.sun_family = AF_UNIX;
+    ipc_socket_path(address.sun_path, sizeof(address.sun_path));
+
+    listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(listen_fd < 0)
+        return;
+
+    // Only if it's our socket, the name is easy to guess and /tmp is shared
+    struct stat st;
+    if(lstat(address.sun_path, &st) == 0 && S_ISSOCK(st.st_mode) && st.st_uid == getuid()
+            && socket_stale(address.sun_path))
+        unlink(address.sun_path);
+    if(bind(listen_fd, (struct sockaddr*)&address, sizeof(address)) < 0 || listen(listen_fd, 8) < 0)
+    {
+        LOG("Failed to open IPC socket %s: %s", address.sun_path, strerror(errno));
+        close(listen_fd);
+        listen_fd = -1;
+        return;
+    }
+
+    // So that programs spawned by the WM can find the socket
+    setenv("TILE_WM_SOCKET", address.sun_path, 1);
+    LOG("IPC socket: %s", address.sun_path);
+}
+
+// The io thread also watches the config file, so it's
+// started even if the socket can't be opened
+int ipc_init(void)
+{
+    for(int i = 0; i < IPC_MAX_CLIENTS; i++)
+        ipc_clients[i].fd = -1;
+
+    listen_socket();
+
+    x_wake = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    io_wake = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if(x_wake < 0 || io_wake < 0
+            || !spsc_init(&requests, IPC_QUEUE_SIZE, sizeof(request_t))
+            || !spsc_init(&replies, IPC_QUEUE_SIZE, sizeof(reply_t)))
+    {
+        LOG("Failed to set up the IPC queues");
+        ipc_deinit();
+        return -1;
+    }
+
+    io_stop = false;
+    if(pthread_create(&io_thread, NULL, io_main, NULL) != 0)
+    {
+        LOG("Failed to start the io thread");
+        ipc_deinit();
+        return -1;
+    }
+    io_running = true;
+
+    return listen_fd >= 0 ? 0 : -1;
+}
+
+void ipc_deinit(void)
+{
+    if(io_running)
+    {
+        __atomic_store_n(&io_stop, true, __ATOMIC_RELEASE);
+        wake(io_wake);
+        pthread_join(io_thread, NULL);
+        io_running = false;
+    }
+
+    for(int i = 0; i < IPC_MAX_CLIENTS; i++)
+        if(ipc_clients[i].fd != -1)
+            client_drop(&ipc_clients[i]);
+
+    if(listen_fd >= 0)
+    {
+        close(listen_fd);
+        unlink(address.sun_path);
+    }
+    listen_fd = -1;
+
+    if(x_wake >= 0)
+        close(x_wake);
+    if(io_wake >= 0)
+        close(io_wake);
+    x_wake = io_wake = -1;
+    spsc_deinit(&requests);
+    spsc_deinit(&replies);
+}
+
+int ipc_fd(void)
+{
+    return x_wake;
+}
+
+static size_t reply_clients(char *buffer, size_t size)
+{
+    size_t len = 0;
+
+    for(client_t *client = wm.head; client != NULL && len < size; client = client->next)
+    {
+        len += snprintf(buffer + len, size - len, "0x%lx 0x%lx %d %d %d %d %d\n",
+                client->window, client->frame,
+                client->x, client->y, client->width, client->height,
+                client == wm.focus);
+    }
+
+    return len < size ? len : size;
+}
+
+// X thread, NULL if the io thread is too far behind, which only
+// costs that reply/event, the X thread never waits for it
+static reply_t* reserve_reply(void)
+{
+    reply_t *reply = spsc_reserve(&replies);
+
+    if(reply == NULL && !replies_full)
+    {
+        LOG("IPC reply queue full, dropping replies until it drains");
+        replies_full = true;
+    }
+    else if(reply != NULL)
+        replies_full = false;
+
+    return reply;
+}
+
+static void handle_request(request_t *request)
+{
+    reply_t *reply = NULL;
+    const char *error = NULL;
+
+    switch(request->type)
+    {
+        case REQUEST_COMMAND:
+            error = action_run(&request->action);
+            if(request->client < 0)
+                return;
+            break;
+        case REQUEST_CONFIG:
+            config_reload();
+            return;
+    }
+
+    reply = reserve_reply();
+    if(reply == NULL)
+        return;
+
+    reply->client = request->client;
+    reply->generation = request->generation;
+    if(request->type == REQUEST_COMMAND)
+    {
+        int len = snprintf(reply->payload, sizeof(reply->payload), "%s", error == NULL ? "ok" : error);
+        reply->type = IPC_COMMAND;
+        reply->len = len < (int)sizeof(reply->payload) ? len : (int)sizeof(reply->payload) - 1;
+    }
+    else if(request->type == REQUEST_GET_CLIENTS)
+    {
+        reply->type = IPC_GET_CLIENTS;
+        reply->len = reply_clients(reply->payload, sizeof(reply->payload));
+    }
+    else
+    {
+        int len = snprintf(reply->payload, sizeof(reply->payload), "%s masters %d weight %.2f clients %d\n",
+                wm.layout == LAYOUT_MONOCLE ? "monocle" : "tile",
+                wm.masters, wm.master_weight, wm.clients);
+        reply->type = IPC_GET_LAYOUT;
+        reply->len = len < (int)sizeof(reply->payload) ? len : (int)sizeof(reply->payload) - 1;
+    }
+
+    spsc_push(&replies);
+    replies_pushed = true;
+}
+
+bool ipc_dispatch(void)
+{
+    request_t *request = NULL;
+    uint64_t count = 0;
+
+    if(x_wake < 0)
+        return false;
+    if(read(x_wake, &count, sizeof(count)) < 0)
+        count = 0; // Nothing new, but there might be leftovers
+
+    for(int i = 0; i < IPC_BATCH && (request = spsc_peek(&requests)) != NULL; i++)
+    {
+        handle_request(request);
+        spsc_pop(&requests);
+    }
+
+    return spsc_peek(&requests) != NULL;
+}
+
+void ipc_flush(void)
+{
+    if(!replies_pushed)
+        return;
+    wake(io_wake);
+    replies_pushed = false;
+}
+
+void ipc_event(enum ipc_event_t event, const char *format, ...)
+{
+    reply_t *reply = NULL;
+    va_list args;
+    int len = 0;
+
+    if((__atomic_load_n(&subscribed, __ATOMIC_RELAXED) & event) == 0 || !io_running)
+        return;
+
+    reply = reserve_reply();
+    if(reply == NULL)
+        return;
+
+    va_start(args, format);
+    len = vsnprintf(reply->payload, sizeof(reply->payload), format, args);
+    va_end(args);
+    if(len < 0)
+        return;
+    else if((size_t)len >= sizeof(reply->payload))
+        len = sizeof(reply->payload) - 1;
+
+    reply->type = IPC_EVENT | event;
+    reply->client = -1;
+    reply->generation = 0;
+    reply->len = len;
+    spsc_push(&replies);
+    replies_pushed = true;
+}
@@ -0,0 +1,73 @@
+#ifndef IPC_H
+#define IPC_H
+
+#include<stdint.h>
+#include<stdlib.h>
+#include<stdio.h>
+#include<stddef.h>
+#include<stdbool.h>
+
+// IPC over a unix domain socket
+// Every message, in both directions, is an 8 byte header followed
+// by `length` bytes of plain text payload (not NULL terminated)
+// Requests are answered with a message of the same type,
+// events are pushed to subscribers with IPC_EVENT set in the type
+//
+// NOTE: This header is also included by tools/ so keep it free of X11 stuff
+
+typedef struct
+{
+    uint32_t length; // payload length in bytes, header not included
+    uint32_t type;
+} ipc_header_t;
+
+enum ipc_message_t
+{
+    IPC_COMMAND = 0,     // "focus next", "masters +1", "weight 0.6", "spawn xterm", "close"...
+    IPC_GET_CLIENTS = 1, // one line per client: window frame x y width height focused
+    IPC_GET_LAYOUT = 2,  // masters, master_weight and client count
+    IPC_SUBSCRIBE = 3,   // payload: comma seperated event names, e.g. "focus,layout,map"
+};
+
+// Events are bit flags so a subscription is just a mask
+#define IPC_EVENT 0x80000000u
+enum ipc_event_t
+{
+    IPC_EVENT_FOCUS  = 1 << 0,
+    IPC_EVENT_LAYOUT = 1 << 1,
+    IPC_EVENT_MAP    = 1 << 2,
+    IPC_EVENT_FRAME  = 1 << 3, // Composite time of every frame, see compositor.h
+    IPC_EVENT_STACK  = 1 << 4, // Requests sent by every restack, see stack.h
+};
+
+#define IPC_MAX_PAYLOAD 4096
+#define IPC_MAX_CLIENTS 32
+// A subscriber which has this much unsent data is too slow
+// and gets disconnected instead of stalling the WM
+#define IPC_OUT_BUFFER (64 * 1024)
+
+// $TILE_WM_SOCKET or $XDG_RUNTIME_DIR/tile_wm<display>.sock
+// /tmp only if there's no XDG_RUNTIME_DIR
+static inline void ipc_socket_path(char *buffer, size_t size)
+{
+    const char *path = getenv("TILE_WM_SOCKET");
+    const char *dir = getenv("XDG_RUNTIME_DIR");
+    const char *display = getenv("DISPLAY");
+
+    if(path != NULL)
+        snprintf(buffer, size, "%s", path);
+    else
+        snprintf(buffer, size, "%s/tile_wm%s.sock", dir != NULL ? dir : "/tmp",
+                display != NULL ? display : ":0");
+}
+
+// WM side, the socket itself is handled on a separate thread, see ipc.c
+// Everything below is called from the X thread
+int ipc_init(void);
+void ipc_deinit(void);
+int ipc_fd(void);        // Readable when there are requests, for poll()
+bool ipc_dispatch(void); // Handles a batch of requests, true if there's more left
+void ipc_flush(void);    // Wakes the io thread if replies/events were queued
+void ipc_event(enum ipc_event_t event, const char *format, ...);
+
+#endif
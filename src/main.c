@@ -2,64 +2,29 @@
 #include<stdio.h>
 #include<stdlib.h>
 #include<X11/Xlib.h>
+#include<X11/Xatom.h>
+#include<X11/Xutil.h>
 #include<X11/keysym.h>
 #include<X11/XKBlib.h>
 #include<unistd.h>
 #include<stdbool.h>
-
-#include "config.h"
-
-#define LOG(...)\
-    fprintf(stderr, __VA_ARGS__);\
-    fprintf(stderr, "\n");
-
-// Each window needs a frame/border
-// The client type exists to pair the window with the border
-// And also to create a linked list to traverse the clients
-struct client_t
-{
-    Window window, frame;
-    bool fullscreen; // Window becomes fullscreen when this is set to true
-    
-    struct client_t *next; // Linked list
-    struct client_t *prev;
-};
-typedef struct client_t client_t;
-
-typedef struct
-{
-    client_t *head, *tail; // Linked list
-
-    // Clients are the total amount of windows in the workspace
-    // Masters is the amount of masters(amount of windows on the left side)
-    int clients, masters; 
-
-    // master_weight = 0.5 means master window takes up 50% of the screen
-    // 0.75 means it takes up 75% etc
-    // Width is calculated by multiplying the screen width with master_weight
-    float master_weight;
-} workspace_t;
-
-// Window manager info
-// Important often needed variables
-// are stored inside this struct
-typedef struct
-{
-    Display *dpy;
-    Window root;
-    bool running; // WM exits whe this becomes false
-
-//    workspace_t workspaces[10];
-    
-    // Keyboard inputs go to the focused client
-    client_t *focus;
-
-    // NOTE: To be replaced with workspaces
-    client_t *head, *tail;
-    int masters, clients;
-    float master_weight;
-} wm_t;
-static wm_t wm;
+#include<poll.h>
+#include<sys/wait.h>
+
+#include "wm.h"
+#include "ipc.h"
+#include "snapshot.h"
+#include "bar.h"
+#include "ewmh.h"
+#include "action.h"
+#include "config_file.h"
+#include "props.h"
+#include "rules.h"
+#include "compositor.h"
+#include "sync.h"
+#include "stack.h"
+
+wm_t wm;
 
 // Functions for handling X11 events
 void handle_map_request(XEvent *ev);
@@ -68,24 +33,32 @@ void handle_destroy(XEvent *ev);
 void handle_configure_request(XEvent *ev);
 void handle_key_press(XEvent *ev);
 void handle_motion(XEvent *ev);
-
-// Functions related to tiling windows
-void default_tiling_layout(void);
-void focus_next(void);
-void focus_prev(void);
-void update_masters(int change);
-
-// General utils functions
-client_t* client_from_frame(Window frame, client_t **ret_prev);
-client_t* client_from_window(Window window, client_t **ret_prev);
-void close_client(client_t *client);
+void handle_expose(XEvent *ev);
+void handle_property_notify(XEvent *ev);
+void handle_client_message(XEvent *ev);
+void handle_enter(XEvent *ev);
+static void send_configure_notify(client_t *client);
+
+// Runs the program through the shell so arguments work, e.g. "xterm -e top"
+// Forks twice, the middle child exits right away and gets reaped here,
+// the program ends up with init as parent and never becomes our zombie
+// NOTE: Not ignoring SIGCHLD instead, that would be inherited by everything spawned
 void exec(const char* program)
 {
-    if(fork() == 0)
+    pid_t pid = fork();
+
+    if(pid == 0)
     {
         setsid();
-        execlp(program, "");
+        if(fork() == 0)
+        {
+            execl("/bin/sh", "sh", "-c", program, (char*)NULL);
+            _exit(1);
+        }
+        _exit(0);
     }
+    if(pid > 0)
+        waitpid(pid, NULL, 0);
 }
 
 // Look up table
@@ -102,16 +75,160 @@ event_lookup_f event_lookup_table[] =
     [KeyPress] = handle_key_press,
     [KeyPress+1 ... MotionNotify-1] = 0,
     [MotionNotify] = handle_motion, // 6
-    [MotionNotify+1 ... DestroyNotify-1] = 0,
+    [EnterNotify] = handle_enter, // 7
+    [EnterNotify+1 ... Expose-1] = 0,
+    [Expose] = handle_expose, // 12
+    [Expose+1 ... DestroyNotify-1] = 0,
     [DestroyNotify] = handle_destroy, // 17
     [UnmapNotify] = handle_unmap_notify, // 18
     [UnmapNotify+1 ... MapRequest-1] = 0,
     [MapRequest] = handle_map_request, // 20
     [MapRequest+1 ... ConfigureRequest-1] = 0,
-    [ConfigureRequest] = handle_map_request, // 23
+    [ConfigureRequest] = handle_configure_request, // 23
+    [ConfigureRequest+1 ... PropertyNotify-1] = 0,
+    [PropertyNotify] = handle_property_notify, // 28
+    [PropertyNotify+1 ... ClientMessage-1] = 0,
+    [ClientMessage] = handle_client_message, // 33
+    [ClientMessage+1 ... LASTEvent-1] = 0,
 };
 
 
+// Events are pulled out of Xlib's queue in batches of up to EVENT_BATCH
+// Input in the batch is handled first, then the structural events,
+// so a key press never waits behind a map/destroy storm
+#define EVENT_BATCH 256
+// While going through structural events Xlib's queue is checked
+// for new input every INPUT_CHECK_INTERVAL events
+#define INPUT_CHECK_INTERVAL 16
+#define INPUT_EVENT_MASK (KeyPressMask | ButtonPressMask | PointerMotionMask)
+
+static bool is_input_event(int type)
+{
+    return type == KeyPress || type == ButtonPress || type == MotionNotify;
+}
+
+static void dispatch(XEvent *ev)
+{
+    // Damage events are past LASTEvent, the compositor also
+    // needs to see map/unmap/configure etc. of every top level window
+    if(compositor_active() && compositor_event(ev))
+        return;
+    if(sync_event(ev))
+        return;
+
+    // call the function in the look up table
+    // and provide a pointer to the event as the arg.
+    // The last index in the array is LASTEvent-1 and all elements
+    // that contain a function pointer are non-zero
+    if(ev->type < LASTEvent && event_lookup_table[ev->type] != 0)
+        event_lookup_table[ev->type](ev); // Call the function and provide pointer to the XEvent as arg
+}
+
+// Goes after every arrange/focus/stack flush, everything that moved windows
+// has been sent by then. Enters with a serial below the no-op are from
+// that and not from the pointer, see handle_enter()
+static void enter_mark(void)
+{
+    if(wm.reconfigured && config.focus_follows_mouse)
+    {
+        wm.enter_serial = NextRequest(wm.dpy);
+        XNoOp(wm.dpy);
+    }
+    wm.reconfigured = false;
+}
+
+// Handles up to EVENT_BATCH events, returns how many
+static int dispatch_batch(void)
+{
+    static XEvent batch[EVENT_BATCH];
+    XEvent ev;
+    int len = 0, input = 0;
+
+    // Reads whatever the server has sent so far, once
+    int queued = XEventsQueued(wm.dpy, QueuedAfterReading);
+    while(len < queued && len < EVENT_BATCH)
+        XNextEvent(wm.dpy, &batch[len++]);
+
+    for(int i = 0; i < len && wm.running; i++)
+    {
+        if(!is_input_event(batch[i].type))
+            continue;
+        dispatch(&batch[i]);
+        input++;
+    }
+
+    // Get whatever the input did on screen before doing anything else
+    if(input > 0)
+    {
+        arrange_flush();
+        focus_flush();
+        stack_flush();
+        enter_mark();
+        XFlush(wm.dpy);
+    }
+
+    for(int i = 0, structural = 0; i < len && wm.running; i++)
+    {
+        if(is_input_event(batch[i].type))
+            continue;
+        dispatch(&batch[i]);
+
+        if(++structural % INPUT_CHECK_INTERVAL == 0)
+            while(wm.running && XCheckMaskEvent(wm.dpy, INPUT_EVENT_MASK, &ev))
+                dispatch(&ev);
+    }
+
+    return len;
+}
+
+// The default handler exits on any error, but windows can be destroyed
+// at any point, so requests on a window we haven't heard the
+// DestroyNotify for yet fail all the time. Those are harmless
+static int handle_x_error(Display *dpy, XErrorEvent *error)
+{
+    char text[128];
+
+    (void)dpy;
+    if(error->error_code == BadWindow || error->error_code == BadMatch || error->error_code == BadDrawable)
+        return 0;
+
+    XGetErrorText(wm.dpy, error->error_code, text, sizeof(text));
+    LOG("X error: %s, request %d.%d", text, error->request_code, error->minor_code);
+    return 0;
+}
+
+// Frame that currently has config.focus_border_color, see focus_flush()
+static client_t *painted = NULL;
+
+static void mru_remove(client_t *client)
+{
+    if(client->mru_prev != NULL)
+        client->mru_prev->mru_next = client->mru_next;
+    else if(wm.mru == client)
+        wm.mru = client->mru_next;
+    if(client->mru_next != NULL)
+        client->mru_next->mru_prev = client->mru_prev;
+    client->mru_next = client->mru_prev = NULL;
+}
+
+static void mru_push(client_t *client)
+{
+    if(wm.mru == client)
+        return;
+
+    mru_remove(client);
+    client->mru_next = wm.mru;
+    if(wm.mru != NULL)
+        wm.mru->mru_prev = client;
+    wm.mru = client;
+}
+
+// Clients ask for where their window goes, the frame's border goes around it
+static int frame_origin(int window_position)
+{
+    return window_position - config.border_width;
+}
+
 // To map an X window means to make it visible
 // This handles a request to make a new window
 // visible. the applicaiton requesting the mapping
@@ -120,7 +237,8 @@ void handle_map_request(XEvent *ev)
 {
     XMapRequestEvent *event = &ev->xmaprequest;
     Window frame = {0};
-    XWindowAttributes window_attrs = {0};
+    props_t props;
+    unsigned int flags = 0;
     client_t *new_client = {0}, *prev_head = wm.head;
 
     for(client_t* client = wm.head; client != NULL; client = client->next)
@@ -133,13 +251,17 @@ void handle_map_request(XEvent *ev)
         }
     }
 
-    XGetWindowAttributes(wm.dpy, event->window, &window_attrs);
+    // Geometry, size hints, state, WM_CLASS etc. in one round trip
+    if(!props_fetch(event->window, &props))
+        return; // Gone before we got to it
+    flags = rules_match(&config.rules, props.values);
 
     // Frame/border for the window
     frame = XCreateSimpleWindow(wm.dpy, wm.root,
-                                window_attrs.x, window_attrs.y,
-                                window_attrs.width, window_attrs.height, 
-                                border_width, border_color, background);
+                                props.x, props.y,
+                                props.width, props.height, 
+                                config.border_width, config.border_color, config.background);
+    stack_add(frame);
 
     // Make the frame the parent of the window.
     // Moving the frame will now also move the window
@@ -147,94 +269,182 @@ void handle_map_request(XEvent *ev)
    LOG("Mapping window: %zu", event->window);
    XMapWindow(wm.dpy, event->window); // Make the window(s) visible
    XMapWindow(wm.dpy, frame);
+   wm.reconfigured = true;
 
-   XSelectInput(wm.dpy, frame, SubstructureNotifyMask | SubstructureRedirectMask);
-   XSync(wm.dpy, True);
+   XSelectInput(wm.dpy, frame, frame_event_mask());
+   XSelectInput(wm.dpy, event->window, PropertyChangeMask); // Title changes
 
-   new_client = (client_t*)malloc(sizeof(client_t));
+   new_client = (client_t*)calloc(1, sizeof(client_t));
 
    // New clients become the new head of the linked list
    // The previous head is pushed 1 position back
    new_client->window = event->window;
    new_client->frame = frame;
+   new_client->floating = (flags & RULE_FLOATING) || props.transient_for != None;
+   client_set_size_hints(new_client, &props.hints);
+   sync_client_add(new_client, props.sync_counter);
    wm.head = new_client;
    new_client->next = prev_head;
    new_client->prev = NULL;
    if(prev_head != NULL)
        prev_head->prev = new_client;
+   else
+       wm.tail = new_client;
+   mru_push(new_client); // focus_client() does this too, unless something is fullscreen
    
    wm.clients++;
-   wm.focus = wm.head; // New window automatically gains focus
+   ewmh_client_add(new_client);
+   ipc_event(IPC_EVENT_MAP, "map 0x%lx", new_client->window);
+
+   // Keeps the size it asked for, centered unless it asked for a position
+   if(new_client->floating)
+   {
+       new_client->float_x = frame_origin(props.x);
+       new_client->float_y = frame_origin(props.y);
+       new_client->float_width = props.width;
+       new_client->float_height = props.height;
+       if(props.x == 0 && props.y == 0)
+       {
+           new_client->float_x = frame_origin((config.screen_width - props.width) / 2);
+           new_client->float_y = frame_origin((config.screen_height - props.height) / 2);
+       }
+       client_move_resize(new_client, new_client->float_x, new_client->float_y,
+               new_client->float_width, new_client->float_height);
+   }
+
+   // e.g. "mpv --fs" asks for fullscreen before it's mapped
+   if((props.net_state & EWMH_STATE_FULLSCREEN) || (flags & RULE_FULLSCREEN))
+       set_fullscreen(new_client, true);
+
+   // Otherwise it stays hidden behind the fullscreen client until that
+   // ends, the new frame goes back under it with the next stack_flush()
+   if(wm.fullscreen == NULL || wm.fullscreen == new_client)
+   {
+       focus_client(wm.head); // New window automatically gains focus
+       arrange();
+   }
+}
 
-   default_tiling_layout();
+// Forgets about the client and gets rid of its frame
+// A window that's still around(withdrawn, not destroyed) is put back
+// on the root first, destroying the frame would take it down with it
+static void unmanage(client_t *client, bool destroyed)
+{
+    Window window = client->window;
+    bool had_focus = false;
+
+    if(!destroyed)
+    {
+        XSelectInput(wm.dpy, window, NoEventMask);
+        XReparentWindow(wm.dpy, window, wm.root, client->x, client->y);
+    }
+    XDestroyWindow(wm.dpy, client->frame);
+    wm.reconfigured = true;
+
+    ewmh_client_remove(client);
+    had_focus = wm.focus == client;
+    if(had_focus) // Nothing to hide in monocle, it's gone
+        wm.focus = NULL;
+    if(wm.fullscreen == client)
+        wm.fullscreen = NULL;
+    if(painted == client)
+        painted = NULL;
+
+    if(client->prev != NULL)
+        client->prev->next = client->next;
+    else
+        wm.head = client->next;
+    if(client->next != NULL)
+        client->next->prev = client->prev;
+    else
+        wm.tail = client->prev;
+    mru_remove(client);
+    sync_client_remove(client);
+    stack_remove(client->frame);
+    free(client);
+
+    ipc_event(IPC_EVENT_MAP, "destroy 0x%lx", window);
+
+    // Focus goes back to whatever was used before, not whatever
+    // happened to be next to it in the stack
+    // If the destroyed window was the last window, then wm.mru will be NULL here
+    if(had_focus)
+        focus_client(wm.mru);
+    wm.clients--;
+    arrange();
 }
 
-// TODO
+// The client unmapped its own window, it wants to be withdrawn(ICCCM 4.1.4)
+// Only our own frames are ever unmapped by us, those aren't clients
+// Windows that are being destroyed get unmapped first, so this also
+// handles most destroys, handle_destroy() only sees windows that never got unmapped
 void handle_unmap_notify(XEvent *ev)
 {
     XUnmapEvent *event = &ev->xunmap;
-    (void)event;
+    client_t *client = client_from_window(event->window, NULL);
+
+    if(client == NULL)
+        return;
     LOG("Unmap");
-//    XUnmapWindow(wm.dpy, event->window);
+    unmanage(client, false);
 }
 
-// TODO use XSendEvent instead of XDestroy and rely on unmap notify
 void handle_destroy(XEvent *ev)
 {
     LOG("DESTROY");
     XDestroyWindowEvent *event = &ev->xdestroywindow;
+    client_t* client = client_from_window(event->window, NULL);
 
-    client_t* prev = {0};
-    client_t* client = client_from_window(event->window, &prev);
     if(client == NULL)
         return;
-
- //   XUnmapWindow(wm.dpy, client->frame);
-//    XUnmapWindow(wm.dpy, client->window);
-
-    if(wm.head->frame == client->frame)
-    {
-        client_t* new_head = client->next;
-        free(client);
-        wm.head = new_head;
-        if(new_head != NULL)
-            new_head->prev = NULL;
-    }else{
-        prev->next = client->next;
-        if(prev->next != NULL)
-            prev->next->prev = prev;
-        free(client);
-    }
-
-    if(prev != NULL)
-        wm.focus = prev;
-    else
-        wm.focus = wm.head;
-    if(wm.focus != NULL) // If the destroyed window was the last window, then wm.focus will be NULL here
-        XSetInputFocus(wm.dpy, wm.focus->window, RevertToPointerRoot, CurrentTime);
-    wm.clients--;
-    default_tiling_layout();
+    unmanage(client, true);
 }
 
-// NOTE: useless right now, might be work making fuctional
-// if going to add floating window support
+// Windows that aren't managed yet get whatever they ask for,
+// floating clients get moved/resized, tiled ones stay where they
+// are and just get told so(ICCCM 4.1.5)
 void handle_configure_request(XEvent *ev)
 {
     XConfigureRequestEvent event = ev->xconfigurerequest;
     XWindowChanges changes = {0};
-   // (void)changes;
+    client_t *client = client_from_window(event.window, NULL);
+
+    if(client == NULL)
+    {
+        changes.x = event.x;
+        changes.y = event.y;
 
-    changes.x = event.x;
-    changes.y = event.y;
+        changes.width = event.width;
+        changes.height = event.height;
+        changes.border_width = event.border_width;
 
-    changes.width = event.width;
-    changes.height = event.height;
-    
-    changes.sibling = event.above;
-    changes.stack_mode = event.detail;
+        changes.sibling = event.above;
+        changes.stack_mode = event.detail;
+
+        XConfigureWindow(wm.dpy, event.window, event.value_mask, &changes);
+        return;
+    }
 
-//    XConfigureWindow(wm.dpy, event.window, event.value_mask, &changes);
+    if(client->floating)
+    {
+        if(event.value_mask & CWX)
+            client->float_x = frame_origin(event.x);
+        if(event.value_mask & CWY)
+            client->float_y = frame_origin(event.y);
+        if(event.value_mask & CWWidth)
+            client->float_width = event.width;
+        if(event.value_mask & CWHeight)
+            client->float_height = event.height;
+
+        if(!client->fullscreen)
+        {
+            client_move_resize(client, client->float_x, client->float_y,
+                    client->float_width, client->float_height);
+            return;
+        }
+    }
 
+    send_configure_notify(client);
 }
 
 // NOTE: Keys must be pressed with modifier key(Left Alt)
@@ -243,46 +453,75 @@ void handle_key_press(XEvent *ev)
     LOG("Key press");
     XKeyEvent event = ev->xkey;
     KeySym keysym;
+    const binding_t *binding = NULL;
+
+    // Always the unshifted keysym, Shift only counts as a modifier
+    // Otherwise shift+h would come in as H and shift+Tab as ISO_Left_Tab
+    keysym = XkbKeycodeToKeysym(wm.dpy, event.keycode, 0, 0);
 
-    keysym = XkbKeycodeToKeysym(wm.dpy, event.keycode, 0,
-            event.state & ShiftMask ? 1 : 0);
+    // Bindings come from config.h and the config file
+    binding = config_binding(keysym, event.state);
+    if(binding != NULL)
+        action_run(&binding->action);
+}
+
+void handle_expose(XEvent *ev)
+{
+    XExposeEvent *event = &ev->xexpose;
+
+    if(bar_owns(event->window))
+        bar_expose(event);
+}
 
-    switch(keysym)
+void handle_property_notify(XEvent *ev)
+{
+    XPropertyEvent *event = &ev->xproperty;
+
+    client_t *client = NULL;
+
+    if(wm.focus != NULL && event->window == wm.focus->window
+            && (event->atom == XA_WM_NAME || event->atom == net_atoms[NET_WM_NAME]))
+        bar_set_title(event->window);
+    else if(event->atom == XA_WM_NORMAL_HINTS && (client = client_from_window(event->window, NULL)) != NULL)
     {
-        case XK_t:
-            exec("/usr/bin/xterm"); // Spawns xterm
-            break;
-        case XK_q:
-            close_client(wm.focus);
-            break;
-        case XK_j:
-            focus_next();
-            break;
-        case XK_k:
-            focus_prev();
-            break;
-        case XK_i:
-            update_masters(1); // Increase master window count by 1
-            break;
-        case XK_d:
-            update_masters(-1);
-            break;
-        case XK_h:
-            wm.master_weight -= 0.05f;
-            default_tiling_layout();
-            break;
-        case XK_l:
-            wm.master_weight += 0.05f;
-            default_tiling_layout();
-            break;
-        case XK_x:
-            wm.running = false;
-            break;
-        default:
-            break;
+        // Same frame, but the window might snap to a different size now
+        client_update_size_hints(client);
+        client_move_resize(client, client->x, client->y, client->width, client->height);
     }
 }
 
+// _NET_* requests from clients and pagers
+void handle_client_message(XEvent *ev)
+{
+    ewmh_client_message(&ev->xclient);
+}
+
+// Sloppy focus, the pointer entering a frame focuses it
+// Every re-tile slides frames around under a pointer that isn't
+// moving, the enters from that are told apart by their serial
+void handle_enter(XEvent *ev)
+{
+    XCrossingEvent *event = &ev->xcrossing;
+    client_t *client = NULL;
+
+    if(!config.focus_follows_mouse || event->mode != NotifyNormal || event->detail == NotifyInferior)
+        return;
+    if(event->serial < wm.enter_serial)
+        return; // Our own configure/map/restack did that
+
+    client = client_from_frame(event->window, NULL);
+    if(client != NULL && client != wm.focus)
+        focus_client(client);
+}
+
+long frame_event_mask(void)
+{
+    long mask = SubstructureNotifyMask | SubstructureRedirectMask;
+    if(config.focus_follows_mouse)
+        mask |= EnterWindowMask;
+    return mask;
+}
+
 // NOTE: practical for debugging
 void handle_motion(XEvent *ev)
 {
@@ -300,72 +539,421 @@ int main(void)
     wm.root = DefaultRootWindow(wm.dpy);
     wm.running = true;
     wm.head = NULL;
+    wm.tail = NULL;
+    wm.mru = NULL;
     wm.masters = 1;
     wm.clients = 0;
     wm.master_weight = 0.5f;
+    wm.layout = LAYOUT_TILE;
     XFlush(wm.dpy);
 
+    config_init();
+
     // WM needs to intercept all events coming to the X server from applications
     XSelectInput(wm.dpy, wm.root, SubstructureNotifyMask | SubstructureRedirectMask);
+    XSync(wm.dpy, False); // Still the default handler, exits if another WM is running
+    XSetErrorHandler(handle_x_error);
 
     // Grabbing keyboard and mouse inputs
+    // Alt and Alt+Shift, see config_binding()
     XGrabKey(wm.dpy, AnyKey, Mod1Mask, wm.root, True, GrabModeAsync, GrabModeAsync);
+    XGrabKey(wm.dpy, AnyKey, Mod1Mask | ShiftMask, wm.root, True, GrabModeAsync, GrabModeAsync);
     XGrabButton(wm.dpy, AnyButton, Mod1Mask, wm.root, True, PointerMotionMask, GrabModeAsync, GrabModeAsync, wm.root, None);
 
-    XEvent ev = {0};
+    // Not fatal, the WM just can't be scripted without it
+    ipc_init();
+    snapshot_init();
+    bar_init(config.screen_width, config.bar_height, config.bar_foreground, config.bar_background);
+    ewmh_init();
+    sync_init(); // Not fatal, resizes just aren't paced
+    if(config.compositor)
+        compositor_init(); // Not fatal either, runs uncomposited
+
+    // fds[0] is the X connection, fds[1] gets woken up by the io thread
+    // IPC and the config file watch live on the io thread, see ipc.c
+    struct pollfd fds[2];
+    bool ipc_pending = false;
+    fds[0] = (struct pollfd){ .fd = ConnectionNumber(wm.dpy), .events = POLLIN };
+    fds[1] = (struct pollfd){ .fd = ipc_fd(), .events = POLLIN }; // poll() skips it if it's -1
+
     XSync(wm.dpy, False); // Sync for good measure
     while(wm.running)
     {
-        XNextEvent(wm.dpy, &ev);
-        // call the function in the look up table
-        // and provide a pointer to the event as the arg.
-        // The last index in the array is 24 and all elements
-        // that contain a function pointer are non-zero
-        if(ev.type < 24 && event_lookup_table[ev.type] != 0)
-            event_lookup_table[ev.type](&ev); // Call the function and provide pointer to the XEvent as arg
+        dispatch_batch();
+        if(!wm.running)
+            break;
+
+        arrange_flush();
+        focus_flush();
+        stack_flush();
+        enter_mark();
+        snapshot_publish();
+        bar_flush();
+        compositor_flush();
+
+        ipc_flush();
+        XFlush(wm.dpy);
+
+        // Xlib may already have read events into its queue, those
+        // won't show up in poll, so don't block while there's any left
+        // Same for IPC requests that didn't fit in the last batch
+        int timeout = ipc_pending || XEventsQueued(wm.dpy, QueuedAlready) > 0 ? 0 : sync_timeout(bar_timeout());
+        if(poll(fds, 2, timeout) < 0)
+            continue; // EINTR
+        bar_tick();
+        sync_tick();
+
+        // IPC commands send X requests, those get flushed by XPending
+        if(ipc_pending || fds[1].revents & POLLIN)
+            ipc_pending = ipc_dispatch();
     }
 
+    compositor_deinit();
+    sync_deinit();
+    ewmh_deinit();
+    stack_deinit();
+    bar_deinit();
+    snapshot_deinit();
+    ipc_deinit();
+    config_deinit();
+    XCloseDisplay(wm.dpy);
     return 0;
 }
 
+// Every layout change goes through here
+// Only marks the layout dirty, 50 windows mapping at once
+// should be one re-tile not 50, see arrange_flush()
+void arrange(void)
+{
+    wm.arrange_pending = true;
+}
+
+// Nothing is visible behind a fullscreen client, so don't touch
+// anything until it's done, set_fullscreen() re-arranges afterwards
+void arrange_flush(void)
+{
+    char layout_text[32];
+
+    if(!wm.arrange_pending || wm.fullscreen != NULL)
+        return;
+    wm.arrange_pending = false;
+
+    if(wm.layout == LAYOUT_MONOCLE)
+        monocle_layout();
+    else
+        default_tiling_layout();
+
+    // Tiled frames that got mapped since could be on top of floating ones
+    stack_touch();
+
+    snprintf(layout_text, sizeof(layout_text), "%s %d",
+            wm.layout == LAYOUT_MONOCLE ? "[M]" : "[]=", wm.clients);
+    bar_set(BAR_SEGMENT_LAYOUT, layout_text);
+
+    snapshot_touch();
+    ipc_event(IPC_EVENT_LAYOUT, "layout %s masters %d weight %.2f clients %d",
+            wm.layout == LAYOUT_MONOCLE ? "monocle" : "tile",
+            wm.masters, wm.master_weight, wm.clients);
+}
+
+void set_layout(layout_t layout)
+{
+    if(wm.layout == layout)
+        return;
+
+    // Monocle hides everything but the focused client
+    if(wm.layout == LAYOUT_MONOCLE)
+    {
+        for(client_t *client = wm.head; client != NULL; client = client->next)
+        {
+            if(client->hidden)
+            {
+                XMapWindow(wm.dpy, client->frame);
+                client->hidden = false;
+                wm.reconfigured = true;
+            }
+        }
+    }
+
+    wm.layout = layout;
+    arrange();
+}
+
 // Will organize windows into the default master-slave layout
 // The master window will be on the left and take up 50% of the screen
 // The slave windows will stack on top of eachother on the right
 // It is possible to increase the number of masters by incrementing wm.masters
 void default_tiling_layout(void)
 {
-    client_t* client = wm.head;
-
     float master_width = wm.master_weight;
+    int tiled = 0, masters = wm.masters, i = 0;
+
+    // The bar takes the top of the screen
+    int top = bar_height();
+    int height = config.screen_height - top;
+
+    // Floating clients aren't part of the layout
+    for(client_t *client = wm.head; client != NULL; client = client->next)
+        if(!client->floating)
+            tiled++;
+    if(masters > tiled)
+        masters = tiled;
     
     // If master is the only window or there are as many masters as there
     // are clients, then the master window(s) should take up the whole width
     // of the screen
-    if(wm.clients == wm.masters)
+    if(tiled == masters)
         master_width = 1.0f;
 
-    for(int i = 0; i < wm.masters && client != NULL; i++)
+    for(client_t *client = wm.head; client != NULL; client = client->next)
+    {
+        if(client->floating)
+            continue;
+
+        if(i < masters)
+            client_move_resize(client,
+                    0, top + (height/masters)*i,
+                    config.screen_width * master_width, height/masters);
+        else
+            // Height of each slave = screen height / total amount of slaves
+            client_move_resize(client,
+                    config.screen_width * wm.master_weight, top + (height/(tiled-masters))*(i-masters),
+                    config.screen_width * (1.0f-wm.master_weight), height/(tiled-masters));
+        i++;
+    }
+}
+
+// Only the focused client is mapped and it gets the whole screen
+// The rest are unmapped(not unmanaged) so they don't render at all
+// Floating clients stay on top of it, if one of them has focus the
+// last focused tiled client is the one that's shown
+// On a focus change only the two frames involved get requests
+void monocle_layout(void)
+{
+    int top = bar_height();
+    client_t *shown = wm.mru;
+
+    while(shown != NULL && shown->floating)
+        shown = shown->mru_next;
+
+    for(client_t *client = wm.head; client != NULL; client = client->next)
+    {
+        if(client->floating)
+            continue;
+        else if(client == shown)
+        {
+            client_move_resize(client, 0, top, config.screen_width, config.screen_height - top);
+            if(client->hidden)
+            {
+                XMapWindow(wm.dpy, client->frame);
+                client->hidden = false;
+                wm.reconfigured = true;
+            }
+        }
+        else if(!client->hidden)
+        {
+            XUnmapWindow(wm.dpy, client->frame);
+            client->hidden = true;
+            wm.reconfigured = true;
+        }
+    }
+}
+
+// Fullscreen clients cover the whole output, including the bar
+// Only one client can be fullscreen at a time
+void set_fullscreen(client_t *client, bool fullscreen)
+{
+    if(client->fullscreen == fullscreen)
+        return;
+
+    if(fullscreen && wm.fullscreen != NULL)
+        set_fullscreen(wm.fullscreen, false);
+
+    client->fullscreen = fullscreen;
+    stack_touch(); // In or out of the fullscreen layer
+    if(fullscreen)
+    {
+        wm.fullscreen = client;
+        ewmh_set_state(client, client->net_state | EWMH_STATE_FULLSCREEN);
+
+        if(client->hidden)
+        {
+            XMapWindow(wm.dpy, client->frame);
+            client->hidden = false;
+        }
+
+        XSetWindowBorderWidth(wm.dpy, client->frame, 0);
+        client_move_resize(client, 0, 0, config.screen_width, config.screen_height);
+    }
+    else
+    {
+        wm.fullscreen = NULL;
+        ewmh_set_state(client, client->net_state & ~EWMH_STATE_FULLSCREEN);
+
+        // Everything that changed in the meantime is applied in one go
+        XSetWindowBorderWidth(wm.dpy, client->frame, config.border_width);
+        if(client->floating)
+            client_move_resize(client, client->float_x, client->float_y,
+                    client->float_width, client->float_height);
+        arrange();
+    }
+}
+
+// Reads WM_NORMAL_HINTS, roundtrip so only call it on PropertyNotify
+// on map they come in with everything else, see props_fetch()
+void client_update_size_hints(client_t *client)
+{
+    XSizeHints hints = {0};
+    long supplied = 0;
+
+    if(!XGetWMNormalHints(wm.dpy, client->window, &hints, &supplied))
+        hints.flags = 0;
+    client_set_size_hints(client, &hints);
+}
+
+void client_set_size_hints(client_t *client, const XSizeHints *hints)
+{
+    client->base_width = client->base_height = 0;
+    client->inc_width = client->inc_height = 0;
+    client->min_width = client->min_height = 0;
+    client->max_width = client->max_height = 0;
+
+    // ICCCM: min size is the base size if there's no base size
+    if(hints->flags & PBaseSize)
     {
-        XMoveResizeWindow(wm.dpy, client->frame,
-                0, (screen_height/wm.masters)*i,
-                screen_width * master_width, screen_height/wm.masters);
-        XMoveResizeWindow(wm.dpy, client->window,
-                0, 0, // Never move the window, only move the frame, learned that the hard way
-                screen_width * master_width, screen_height/wm.masters);
-        client = client->next;
+        client->base_width = hints->base_width;
+        client->base_height = hints->base_height;
+    }
+    else if(hints->flags & PMinSize)
+    {
+        client->base_width = hints->min_width;
+        client->base_height = hints->min_height;
     }
 
-    for(int i = 0; i < wm.clients - wm.masters && client != NULL; i++)
+    if(hints->flags & PResizeInc)
     {
-        // Height of each slave = screen height / total amount of slaves
-        XMoveResizeWindow(wm.dpy, client->frame,
-                screen_width * wm.master_weight, (screen_height/(wm.clients-wm.masters))*i,
-                screen_width * (1.0f-wm.master_weight), screen_height/(wm.clients-wm.masters));
-        XMoveResizeWindow(wm.dpy, client->window,
-                0, 0,
-                screen_width * (1.0f-wm.master_weight), screen_height/(wm.clients-wm.masters));
-        client = client->next;
+        client->inc_width = hints->width_inc;
+        client->inc_height = hints->height_inc;
     }
+    if(hints->flags & PMinSize)
+    {
+        client->min_width = hints->min_width;
+        client->min_height = hints->min_height;
+    }
+    if(hints->flags & PMaxSize)
+    {
+        client->max_width = hints->max_width;
+        client->max_height = hints->max_height;
+    }
+}
+
+// Largest size <= the given size that the client actually wants
+// e.g. a terminal gets a whole number of cells so it doesn't reflow
+static void snap_to_size_hints(client_t *client, int *width, int *height)
+{
+    if(client->inc_width > 1 && *width > client->base_width)
+        *width -= (*width - client->base_width) % client->inc_width;
+    if(client->inc_height > 1 && *height > client->base_height)
+        *height -= (*height - client->base_height) % client->inc_height;
+
+    if(client->max_width > 0 && *width > client->max_width)
+        *width = client->max_width;
+    if(client->max_height > 0 && *height > client->max_height)
+        *height = client->max_height;
+
+    // Min size only if it fits, otherwise the window pokes out of the frame
+    if(*width < client->min_width && client->min_width <= client->width)
+        *width = client->min_width;
+    if(*height < client->min_height && client->min_height <= client->height)
+        *height = client->min_height;
+
+    if(*width < 1)
+        *width = 1;
+    if(*height < 1)
+        *height = 1;
+}
+
+// Tells the client where it ended up when only the frame moved, ICCCM 4.2.3
+static void send_configure_notify(client_t *client)
+{
+    // Root coordinates of the window, it sits inside the frame's border
+    int border = client->fullscreen ? 0 : config.border_width;
+    XConfigureEvent event = {
+        .type = ConfigureNotify,
+        .display = wm.dpy,
+        .event = client->window,
+        .window = client->window,
+        .x = client->x + border,
+        .y = client->y + border,
+        .width = client->window_width,
+        .height = client->window_height,
+        .border_width = 0,
+        .above = None,
+        .override_redirect = False,
+    };
+
+    XSendEvent(wm.dpy, client->window, False, StructureNotifyMask, (XEvent*)&event);
+}
+
+// Moves the frame and resizes the window inside of it
+// The frame always gets the whole tile, the window is snapped to
+// its size hints and only resized if that gives a new size
+void client_move_resize(client_t *client, int x, int y, int width, int height)
+{
+    bool moved = client->x != x || client->y != y;
+    int window_width = width, window_height = height;
+
+    if(moved || client->width != width || client->height != height)
+    {
+        XMoveResizeWindow(wm.dpy, client->frame, x, y, width, height);
+        wm.reconfigured = true;
+        snapshot_touch(); // Not everything that moves clients goes through arrange()
+    }
+
+    client->x = x;
+    client->y = y;
+    client->width = width;
+    client->height = height;
+
+    if(!client->fullscreen)
+        snap_to_size_hints(client, &window_width, &window_height);
+
+    if(client->window_width == window_width && client->window_height == window_height)
+    {
+        // Back to the size it already has, nothing left to send later
+        client->sync_width = client->sync_height = 0;
+        if(moved)
+            send_configure_notify(client);
+    }
+    else if(sync_resize(client, window_width, window_height))
+    {
+        // Never move the window, only move the frame, learned that the hard way
+        XResizeWindow(wm.dpy, client->window, window_width, window_height);
+        client->window_width = window_width;
+        client->window_height = window_height;
+    }
+    else if(moved) // Size comes once it has painted the last one, see sync.h
+        send_configure_notify(client);
+}
+
+// Every focus change goes through here, NULL means nothing has focus
+void focus_client(client_t *client)
+{
+    client_t *old = wm.focus;
+
+    // Monocle only has the focused client mapped
+    if(wm.layout == LAYOUT_MONOCLE && client != old)
+        arrange();
+
+    // Focused floating client goes on top of the other floating ones
+    if(client != NULL && client != old && client->floating)
+        stack_touch();
+
+    wm.focus = client;
+    if(client != NULL)
+        mru_push(client);
+    snapshot_touch();
+    bar_set_title(client != NULL ? client->window : None);
 }
 
 void focus_next(void)
@@ -374,20 +962,58 @@ void focus_next(void)
     if(wm.focus == NULL)
         return;
     else if(wm.focus->next == NULL)
-        wm.focus = wm.head;
+        focus_client(wm.head);
     else
-        wm.focus = wm.focus->next;
-
-    XSetInputFocus(wm.dpy, wm.focus->window, RevertToPointerRoot, CurrentTime);
+        focus_client(wm.focus->next);
 }
-// TODO
 void focus_prev(void)
 {
+    // If at top of stack, go to the bottom
     if(wm.focus == NULL)
         return;
-    wm.focus = wm.focus->prev;
+    else if(wm.focus->prev == NULL)
+        focus_client(wm.tail);
+    else
+        focus_client(wm.focus->prev);
+}
+
+void focus_last(void)
+{
+    // Focused client is at the front unless focus was lost
+    client_t *client = wm.mru;
+    if(client != NULL && client == wm.focus)
+        client = client->mru_next;
+    if(client != NULL)
+        focus_client(client);
+}
+
+// Focus is only sent to the server here, so any amount of focus
+// changes between two flushes(e.g. the pointer crossing a few frames)
+// costs one XSetInputFocus and at most two XSetWindowBorder calls
+void focus_flush(void)
+{
+    static Window input_focus = None;
+    Window window = wm.focus != NULL ? wm.focus->window : None;
+
+    if(window != input_focus)
+    {
+        input_focus = window;
+        ewmh_set_active(wm.focus);
+        if(wm.focus != NULL)
+        {
+            XSetInputFocus(wm.dpy, window, RevertToPointerRoot, CurrentTime);
+            ipc_event(IPC_EVENT_FOCUS, "focus 0x%lx", window);
+        }
+    }
+
+    if(painted == wm.focus)
+        return;
 
-    XSetInputFocus(wm.dpy, wm.focus->window, RevertToPointerRoot, CurrentTime);
+    if(painted != NULL)
+        XSetWindowBorder(wm.dpy, painted->frame, config.border_color);
+    if(wm.focus != NULL)
+        XSetWindowBorder(wm.dpy, wm.focus->frame, config.focus_border_color);
+    painted = wm.focus;
 }
 
 // Increment or decrement the total amont of masters
@@ -400,7 +1026,20 @@ void update_masters(int change)
 
     wm.masters += change;
 
-    default_tiling_layout();
+    arrange();
+}
+
+// Nudge master_weight, but never let either side disappear
+void update_master_weight(float change)
+{
+    float weight = wm.master_weight + change;
+
+    if(weight < 0.05f || weight > 0.95f)
+        return;
+
+    wm.master_weight = weight;
+
+    arrange();
 }
 
 // Client from frame or from window simply returns a pointer to
@@ -440,24 +1079,40 @@ client_t* client_from_window(Window window, client_t **ret_prev)
     return NULL;
 }
 
-// TODO: Use XSendEvent instead of XDestroyWindow
+// Asks nicely with WM_DELETE_WINDOW if the client takes it(ICCCM 4.2.8.1),
+// otherwise its connection gets killed. Either way the window goes
+// away on its own and the client is unmanaged on the unmap/destroy
 void close_client(client_t *client)
 {
+    Atom delete_atom = XInternAtom(wm.dpy, "WM_DELETE_WINDOW", False);
+    Atom *protocols = NULL;
+    bool polite = false;
+    int len = 0;
+
     LOG("Close client");
     if(client == NULL)
         return;
-    XEvent event;
-    event.xclient.type = ClientMessage;
-    event.xclient.window = wm.head->frame;
-    event.xclient.message_type = XInternAtom(wm.dpy, "WM_PROTOCOLS", True);
-    event.xclient.format = 32;
-    event.xclient.data.l[0] = XInternAtom(wm.dpy, "WM_DELETE_WINDOW", False);
-    event.xclient.data.l[1] = CurrentTime;
-    (void)event;
 
-    XDestroyWindow(wm.dpy, client->frame);
+    if(XGetWMProtocols(wm.dpy, client->window, &protocols, &len))
+    {
+        for(int i = 0; i < len; i++)
+            polite |= protocols[i] == delete_atom;
+        XFree(protocols);
+    }
 
-//    XSendEvent(wm.dpy, wm.head->frame, False, NoEventMask, &event);
+    if(!polite)
+    {
+        XKillClient(wm.dpy, client->window);
+        return;
+    }
 
+    XEvent event = {0};
+    event.xclient.type = ClientMessage;
+    event.xclient.window = client->window;
+    event.xclient.message_type = XInternAtom(wm.dpy, "WM_PROTOCOLS", False);
+    event.xclient.format = 32;
+    event.xclient.data.l[0] = delete_atom;
+    event.xclient.data.l[1] = CurrentTime;
+    XSendEvent(wm.dpy, client->window, False, NoEventMask, &event);
 }
 
@@ -0,0 +1,166 @@
+#include<string.h>
+#include<stdlib.h>
+#include<X11/Xatom.h>
+#include<X11/Xlib-xcb.h>
+#include<xcb/xcb.h>
+
+#include "wm.h"
+#include "ewmh.h"
+#include "props.h"
+
+// WM_SIZE_HINTS on the wire, see ICCCM 4.1.2.3
+enum
+{
+    HINT_FLAGS = 0,
+    HINT_MIN_WIDTH = 5, HINT_MIN_HEIGHT,
+    HINT_MAX_WIDTH, HINT_MAX_HEIGHT,
+    HINT_WIDTH_INC, HINT_HEIGHT_INC,
+    HINT_BASE_WIDTH = 15, HINT_BASE_HEIGHT,
+    HINT_ELEMENTS = 18,
+    HINT_OLD_ELEMENTS = 15, // Pre ICCCM 1.0, no base size or gravity
+};
+
+static Atom role_atom = None, protocols_atom = None;
+
+static void copy_string(char *buffer, size_t size, const void *value, int len)
+{
+    if(len < 0)
+        len = 0;
+    if((size_t)len >= size)
+        len = size - 1;
+    memcpy(buffer, value, len);
+    buffer[len] = '\0';
+}
+
+static void parse_hints(xcb_get_property_reply_t *reply, XSizeHints *hints)
+{
+    const uint32_t *data = xcb_get_property_value(reply);
+    int len = xcb_get_property_value_length(reply) / 4;
+
+    if(reply->format != 32 || len < HINT_OLD_ELEMENTS)
+        return;
+
+    hints->flags = data[HINT_FLAGS];
+    hints->min_width = data[HINT_MIN_WIDTH];
+    hints->min_height = data[HINT_MIN_HEIGHT];
+    hints->max_width = data[HINT_MAX_WIDTH];
+    hints->max_height = data[HINT_MAX_HEIGHT];
+    hints->width_inc = data[HINT_WIDTH_INC];
+    hints->height_inc = data[HINT_HEIGHT_INC];
+
+    // Same as XGetWMNormalHints does for old clients
+    if(len < HINT_ELEMENTS)
+        hints->flags &= ~(PBaseSize | PWinGravity);
+    else
+    {
+        hints->base_width = data[HINT_BASE_WIDTH];
+        hints->base_height = data[HINT_BASE_HEIGHT];
+    }
+}
+
+bool props_fetch(Window window, props_t *props)
+{
+    xcb_connection_t *c = XGetXCBConnection(wm.dpy);
+    xcb_get_property_reply_t *reply = NULL;
+    xcb_get_geometry_reply_t *geometry = NULL;
+
+    memset(props, 0, sizeof(props_t));
+
+    // Only ever costs a round trip the first time
+    if(role_atom == None)
+    {
+        role_atom = XInternAtom(wm.dpy, "WM_WINDOW_ROLE", False);
+        protocols_atom = XInternAtom(wm.dpy, "WM_PROTOCOLS", False);
+    }
+
+    // Everything goes out at once
+    xcb_get_geometry_cookie_t geometry_cookie = xcb_get_geometry(c, window);
+    xcb_get_property_cookie_t hints_cookie = xcb_get_property(c, 0, window,
+            XA_WM_NORMAL_HINTS, XA_WM_SIZE_HINTS, 0, HINT_ELEMENTS);
+    xcb_get_property_cookie_t state_cookie = xcb_get_property(c, 0, window,
+            net_atoms[NET_WM_STATE], XA_ATOM, 0, 32);
+    xcb_get_property_cookie_t transient_cookie = xcb_get_property(c, 0, window,
+            XA_WM_TRANSIENT_FOR, XA_WINDOW, 0, 1);
+    xcb_get_property_cookie_t class_cookie = xcb_get_property(c, 0, window,
+            XA_WM_CLASS, XA_STRING, 0, sizeof(props->class_buffer) / 4);
+    xcb_get_property_cookie_t role_cookie = xcb_get_property(c, 0, window,
+            role_atom, XA_STRING, 0, sizeof(props->role_buffer) / 4);
+    xcb_get_property_cookie_t protocols_cookie = xcb_get_property(c, 0, window,
+            protocols_atom, XA_ATOM, 0, 32);
+    xcb_get_property_cookie_t counter_cookie = xcb_get_property(c, 0, window,
+            net_atoms[NET_WM_SYNC_REQUEST_COUNTER], XA_CARDINAL, 0, 1);
+
+    // Replies come back in the same order, errors(window already
+    // destroyed) are just freed, a NULL reply is enough to go on
+    geometry = xcb_get_geometry_reply(c, geometry_cookie, NULL);
+    if(geometry != NULL)
+    {
+        props->x = geometry->x;
+        props->y = geometry->y;
+        props->width = geometry->width;
+        props->height = geometry->height;
+    }
+
+    reply = xcb_get_property_reply(c, hints_cookie, NULL);
+    if(reply != NULL)
+        parse_hints(reply, &props->hints);
+    free(reply);
+
+    reply = xcb_get_property_reply(c, state_cookie, NULL);
+    if(reply != NULL && reply->format == 32)
+    {
+        const uint32_t *atoms = xcb_get_property_value(reply);
+        int len = xcb_get_property_value_length(reply) / 4;
+        for(int i = 0; i < len; i++)
+            props->net_state |= ewmh_state_from_atom(atoms[i]);
+    }
+    free(reply);
+
+    reply = xcb_get_property_reply(c, transient_cookie, NULL);
+    if(reply != NULL && reply->format == 32 && xcb_get_property_value_length(reply) >= 4)
+        props->transient_for = *(uint32_t*)xcb_get_property_value(reply);
+    free(reply);
+
+    // "instance\0class\0"
+    reply = xcb_get_property_reply(c, class_cookie, NULL);
+    if(reply != NULL && reply->format == 8 && xcb_get_property_value_length(reply) > 0)
+    {
+        size_t len = 0;
+        copy_string(props->class_buffer, sizeof(props->class_buffer),
+                xcb_get_property_value(reply), xcb_get_property_value_length(reply));
+        len = strlen(props->class_buffer);
+        props->values[RULE_INSTANCE] = props->class_buffer;
+        if(len + 1 < (size_t)xcb_get_property_value_length(reply) && len + 1 < sizeof(props->class_buffer))
+            props->values[RULE_CLASS] = props->class_buffer + len + 1;
+    }
+    free(reply);
+
+    reply = xcb_get_property_reply(c, role_cookie, NULL);
+    if(reply != NULL && reply->format == 8 && xcb_get_property_value_length(reply) > 0)
+    {
+        copy_string(props->role_buffer, sizeof(props->role_buffer),
+                xcb_get_property_value(reply), xcb_get_property_value_length(reply));
+        props->values[RULE_ROLE] = props->role_buffer;
+    }
+    free(reply);
+
+    // The counter alone doesn't mean anything, the protocol has to be there too
+    reply = xcb_get_property_reply(c, protocols_cookie, NULL);
+    bool sync = false;
+    if(reply != NULL && reply->format == 32)
+    {
+        const uint32_t *atoms = xcb_get_property_value(reply);
+        int len = xcb_get_property_value_length(reply) / 4;
+        for(int i = 0; i < len; i++)
+            sync |= atoms[i] == net_atoms[NET_WM_SYNC_REQUEST];
+    }
+    free(reply);
+
+    reply = xcb_get_property_reply(c, counter_cookie, NULL);
+    if(sync && reply != NULL && reply->format == 32 && xcb_get_property_value_length(reply) >= 4)
+        props->sync_counter = *(uint32_t*)xcb_get_property_value(reply);
+    free(reply);
+
+    free(geometry);
+    return geometry != NULL;
+}
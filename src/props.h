@@ -0,0 +1,32 @@
+#ifndef PROPS_H
+#define PROPS_H
+
+#include<X11/Xlib.h>
+#include<X11/Xutil.h>
+#include<stdbool.h>
+
+#include "rules.h"
+
+// Everything handle_map_request() wants to know about a new window
+// All of the requests are sent at once through XCB and only then are
+// the replies collected, so it's one round trip instead of one per
+// property, which adds up when a lot of windows map at once
+typedef struct
+{
+    int x, y, width, height;
+
+    XSizeHints hints; // flags is 0 if there's no WM_NORMAL_HINTS
+    unsigned int net_state; // ewmh_state_t
+    Window transient_for; // None if it isn't a dialog or similar
+    XID sync_counter; // None unless WM_PROTOCOLS has _NET_WM_SYNC_REQUEST
+
+    // For rules_match(), NULL if the window doesn't have it
+    const char *values[RULE_KEYS];
+    char class_buffer[2 * RULE_VALUE_MAX];
+    char role_buffer[RULE_VALUE_MAX];
+} props_t;
+
+// false if the window is already gone
+bool props_fetch(Window window, props_t *props);
+
+#endif
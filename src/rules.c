@@ -0,0 +1,131 @@
+#include<string.h>
+
+#include "rules.h"
+
+static const char *key_names[RULE_KEYS] = { "instance", "class", "role" };
+
+// FNV-1a
+static unsigned int hash(const char *string)
+{
+    unsigned int h = 2166136261u;
+    while(*string != '\0')
+        h = (h ^ (unsigned char)*string++) * 16777619u;
+    return h & (RULE_BUCKETS - 1);
+}
+
+void rules_clear(ruleset_t *set)
+{
+    set->len = 0;
+    memset(set->buckets, 0xff, sizeof(set->buckets)); // All -1
+}
+
+static const char* add_word(rule_t *rule, const char *word, size_t len)
+{
+    const char *equals = memchr(word, '=', len);
+
+    if(equals == NULL)
+    {
+        if(len == 8 && strncmp(word, "floating", len) == 0)
+            rule->flags |= RULE_FLOATING;
+        else if(len == 10 && strncmp(word, "fullscreen", len) == 0)
+            rule->flags |= RULE_FULLSCREEN;
+        else
+            return "unknown rule flag, expected floating or fullscreen";
+        return NULL;
+    }
+
+    for(int key = 0; key < RULE_KEYS; key++)
+    {
+        size_t name_len = strlen(key_names[key]);
+        size_t value_len = len - name_len - 1;
+
+        if((size_t)(equals - word) != name_len || strncmp(word, key_names[key], name_len) != 0)
+            continue;
+        if(value_len == 0 || value_len >= RULE_VALUE_MAX)
+            return "rule value is empty or too long";
+
+        memcpy(rule->value[key], equals + 1, value_len);
+        rule->value[key][value_len] = '\0';
+        rule->keys |= 1u << key;
+        return NULL;
+    }
+
+    return "unknown rule key, expected instance, class or role";
+}
+
+const char* rules_add(ruleset_t *set, const char *string)
+{
+    rule_t rule = {0};
+    const char *error = NULL;
+    int key = 0;
+
+    if(set->len == RULES_MAX)
+        return "too many rules";
+
+    while(*string != '\0')
+    {
+        size_t len = 0;
+        while(*string == ' ' || *string == '\t')
+            string++;
+        len = strcspn(string, " \t");
+        if(len == 0)
+            break;
+
+        error = add_word(&rule, string, len);
+        if(error != NULL)
+            return error;
+        string += len;
+    }
+
+    if(rule.keys == 0)
+        return "rule doesn't match on anything";
+    if(rule.flags == 0)
+        return "rule doesn't do anything";
+
+    // Only goes into the bucket of the first key it matches on,
+    // the other keys get compared once that one matched
+    while(!(rule.keys & (1u << key)))
+        key++;
+
+    unsigned int bucket = hash(rule.value[key]);
+    rule.next = set->buckets[key][bucket];
+    set->buckets[key][bucket] = set->len;
+    set->rules[set->len++] = rule;
+    return NULL;
+}
+
+static bool rule_matches(const rule_t *rule, const char *values[RULE_KEYS])
+{
+    for(int key = 0; key < RULE_KEYS; key++)
+    {
+        if(!(rule->keys & (1u << key)))
+            continue;
+        if(values[key] == NULL || strcmp(rule->value[key], values[key]) != 0)
+            return false;
+    }
+    return true;
+}
+
+unsigned int rules_match(const ruleset_t *set, const char *values[RULE_KEYS])
+{
+    unsigned int flags = 0;
+
+    if(set->len == 0)
+        return 0;
+
+    for(int key = 0; key < RULE_KEYS; key++)
+    {
+        if(values[key] == NULL)
+            continue;
+
+        for(int i = set->buckets[key][hash(values[key])]; i >= 0; i = set->rules[i].next)
+        {
+            const rule_t *rule = &set->rules[i];
+            // Bucket is shared with other values that hash the same
+            if(rule_matches(rule, values))
+                flags |= rule->flags;
+        }
+    }
+
+    return flags;
+}
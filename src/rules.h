@@ -0,0 +1,58 @@
+#ifndef RULES_H
+#define RULES_H
+
+#include<stdbool.h>
+
+// Per application rules, e.g. in the config file:
+//   rule = class=mpv fullscreen
+//   rule = instance=xterm class=XTerm floating
+//   rule = role=pop-up floating
+//
+// Every word with a = in it is something to match, all of them have
+// to match exactly. The rest are flags that get applied.
+//
+// Rules are hashed on load by the first thing they match on, so
+// matching a window is a few hash lookups no matter how many rules
+// there are, only rules with the same value are ever compared
+
+enum rule_key_t
+{
+    RULE_INSTANCE = 0, // WM_CLASS, first string
+    RULE_CLASS,        // WM_CLASS, second string
+    RULE_ROLE,         // WM_WINDOW_ROLE
+    RULE_KEYS
+};
+
+enum rule_flag_t
+{
+    RULE_FLOATING   = 1 << 0,
+    RULE_FULLSCREEN = 1 << 1,
+};
+
+#define RULES_MAX 64
+#define RULE_BUCKETS 128 // Per key, power of 2
+#define RULE_VALUE_MAX 64
+
+typedef struct
+{
+    char value[RULE_KEYS][RULE_VALUE_MAX];
+    unsigned int keys;  // 1 << rule_key_t for every key that has to match
+    unsigned int flags; // rule_flag_t
+    int next;           // Next rule in the same bucket, -1 at the end
+} rule_t;
+
+// Plain arrays so config_t can still be copied around as a whole
+typedef struct
+{
+    rule_t rules[RULES_MAX];
+    int len;
+    int buckets[RULE_KEYS][RULE_BUCKETS]; // First rule in each, -1 if empty
+} ruleset_t;
+
+void rules_clear(ruleset_t *set);
+// Returns NULL on success, otherwise a string describing what's wrong
+const char* rules_add(ruleset_t *set, const char *string);
+// values[key] can be NULL if the window doesn't have it, returns rule_flag_t
+unsigned int rules_match(const ruleset_t *set, const char *values[RULE_KEYS]);
+
+#endif
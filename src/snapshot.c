@@ -0,0 +1,111 @@
+#include<errno.h>
+#include<fcntl.h>
+#include<unistd.h>
+#include<stddef.h>
+#include<sys/mman.h>
+
+#include "wm.h"
+#include "snapshot.h"
+
+static snapshot_t *shared = NULL; // The mmap'ed file
+static snapshot_t last; // What was published last, to skip writes that change nothing
+static char path[256];
+static bool touched = false;
+
+int snapshot_init(void)
+{
+    int fd = -1;
+
+    snapshot_path(path, sizeof(path));
+    // Always a new file, so a symlink or a file someone else put there
+    // beforehand(the name is easy to guess) can't make us write somewhere else
+    // Ours from a crashed session just gets removed first
+    unlink(path);
+    fd = open(path, O_RDWR | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, 0644);
+    if(fd < 0 || ftruncate(fd, sizeof(snapshot_t)) < 0)
+    {
+        LOG("Failed to create snapshot %s: %s", path, strerror(errno));
+        if(fd >= 0)
+            close(fd);
+        return -1;
+    }
+
+    shared = mmap(NULL, sizeof(snapshot_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd); // Mapping stays valid
+    if(shared == MAP_FAILED)
+    {
+        shared = NULL;
+        return -1;
+    }
+
+    memset(&last, 0, sizeof(last));
+    last.version = SNAPSHOT_VERSION;
+    memcpy(shared, &last, sizeof(last));
+
+    touched = true;
+    LOG("State snapshot: %s", path);
+    return 0;
+}
+
+void snapshot_deinit(void)
+{
+    if(shared == NULL)
+        return;
+
+    munmap(shared, sizeof(snapshot_t));
+    unlink(path);
+    shared = NULL;
+}
+
+void snapshot_touch(void)
+{
+    touched = true;
+}
+
+// Called once per main loop iteration, so a burst of
+// changes ends up as a single write
+void snapshot_publish(void)
+{
+    snapshot_t next;
+    uint32_t seq = 0;
+
+    if(shared == NULL || !touched)
+        return;
+    touched = false;
+
+    // memset instead of = {0} so the padding is zeroed too for memcmp
+    memset(&next, 0, sizeof(next));
+    next.version = SNAPSHOT_VERSION;
+    next.focus = wm.focus != NULL ? wm.focus->window : 0;
+    next.layout = wm.layout == LAYOUT_MONOCLE ? SNAPSHOT_LAYOUT_MONOCLE : SNAPSHOT_LAYOUT_TILE;
+    next.masters = wm.masters;
+    next.master_weight = wm.master_weight;
+    next.clients = wm.clients;
+
+    for(client_t *client = wm.head; client != NULL && next.len < SNAPSHOT_MAX_CLIENTS; client = client->next)
+    {
+        next.client[next.len++] = (snapshot_client_t){
+            .window = client->window, .frame = client->frame,
+            .x = client->x, .y = client->y,
+            .width = client->width, .height = client->height,
+        };
+    }
+
+    // seq is the only field which differs between last and next
+    next.seq = last.seq;
+    if(memcmp(&next, &last, sizeof(snapshot_t)) == 0)
+        return;
+
+    // Odd seq tells readers a write is in progress
+    seq = last.seq;
+    __atomic_store_n(&shared->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    memcpy((char*)shared + offsetof(snapshot_t, focus), (char*)&next + offsetof(snapshot_t, focus),
+            sizeof(snapshot_t) - offsetof(snapshot_t, focus));
+
+    __atomic_store_n(&shared->seq, seq + 2, __ATOMIC_RELEASE);
+
+    next.seq = seq + 2;
+    last = next;
+}
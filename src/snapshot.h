@@ -0,0 +1,91 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include<stdint.h>
+#include<stdlib.h>
+#include<stdio.h>
+#include<string.h>
+#include<stdbool.h>
+
+// The WM publishes its state into a memory mapped file so that
+// status bars etc. can read it without any syscalls or IPC traffic
+// Just mmap the file once and call snapshot_read() whenever
+//
+// Writes are guarded by a seqlock: seq is odd while the WM is writing
+// and gets bumped to the next even number once it's done, a reader
+// retries if seq was odd or changed while it was copying
+//
+// NOTE: This header is also meant for readers, keep it free of X11 stuff
+
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_MAX_CLIENTS 64
+
+enum snapshot_layout_t
+{
+    SNAPSHOT_LAYOUT_TILE = 0,
+    SNAPSHOT_LAYOUT_MONOCLE = 1,
+};
+
+typedef struct
+{
+    uint64_t window, frame;
+    int32_t x, y, width, height;
+} snapshot_client_t;
+
+typedef struct
+{
+    uint32_t version;
+    uint32_t seq;
+
+    uint64_t focus; // Window, 0 if nothing has focus
+    int32_t layout;
+    int32_t masters;
+    float master_weight;
+
+    int32_t clients; // Can be more than SNAPSHOT_MAX_CLIENTS
+    int32_t len;     // Amount of valid entries in client
+    snapshot_client_t client[SNAPSHOT_MAX_CLIENTS]; // Same order as the stack, head first
+} snapshot_t;
+
+// $TILE_WM_SNAPSHOT or $XDG_RUNTIME_DIR/tile_wm<display>.state
+// /dev/shm only if there's no XDG_RUNTIME_DIR, anyone can create files in there
+static inline void snapshot_path(char *buffer, size_t size)
+{
+    const char *path = getenv("TILE_WM_SNAPSHOT");
+    const char *dir = getenv("XDG_RUNTIME_DIR");
+    const char *display = getenv("DISPLAY");
+
+    if(path != NULL)
+        snprintf(buffer, size, "%s", path);
+    else
+        snprintf(buffer, size, "%s/tile_wm%s.state", dir != NULL ? dir : "/dev/shm",
+                display != NULL ? display : ":0");
+}
+
+// Copies a consistent snapshot out of the shared mapping
+// Returns false if the mapping isn't something we understand
+static inline bool snapshot_read(const snapshot_t *shared, snapshot_t *copy)
+{
+    uint32_t begin = 0, end = 0;
+
+    if(__atomic_load_n(&shared->version, __ATOMIC_RELAXED) != SNAPSHOT_VERSION)
+        return false;
+
+    do
+    {
+        begin = __atomic_load_n(&shared->seq, __ATOMIC_ACQUIRE);
+        memcpy(copy, shared, sizeof(snapshot_t));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        end = __atomic_load_n(&shared->seq, __ATOMIC_RELAXED);
+    }while((begin & 1) || begin != end);
+
+    return true;
+}
+
+// WM side
+int snapshot_init(void);
+void snapshot_deinit(void);
+void snapshot_touch(void);   // Something that's in the snapshot might have changed
+void snapshot_publish(void); // Writes the snapshot if anything actually changed
+
+#endif
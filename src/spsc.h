@@ -0,0 +1,91 @@
+#ifndef SPSC_H
+#define SPSC_H
+
+#include<stdint.h>
+#include<stdlib.h>
+#include<stdbool.h>
+
+// Lock-free single producer, single consumer ring of fixed size slots
+// Exactly one thread may push and exactly one other thread may pop
+//
+// head is only written by the consumer and tail only by the producer,
+// they're on their own cache lines so the two threads don't keep
+// stealing the line from each other. Each side also keeps a copy of
+// the other side's index and only re-reads it when the ring looks
+// full/empty, so most pushes and pops don't touch the shared line at all
+
+#define SPSC_CACHE_LINE 64
+
+typedef struct
+{
+    _Alignas(SPSC_CACHE_LINE) uint32_t head; // Next slot to pop
+    uint32_t cached_tail; // Consumer's copy of tail
+
+    _Alignas(SPSC_CACHE_LINE) uint32_t tail; // Next slot to push
+    uint32_t cached_head; // Producer's copy of head
+
+    _Alignas(SPSC_CACHE_LINE) uint32_t mask; // size - 1
+    size_t slot_size;
+    char *slots;
+} spsc_t;
+
+// size has to be a power of 2
+static inline bool spsc_init(spsc_t *queue, uint32_t size, size_t slot_size)
+{
+    queue->head = queue->cached_tail = 0;
+    queue->tail = queue->cached_head = 0;
+    queue->mask = size - 1;
+    queue->slot_size = slot_size;
+    queue->slots = calloc(size, slot_size);
+    return queue->slots != NULL;
+}
+
+static inline void spsc_deinit(spsc_t *queue)
+{
+    free(queue->slots);
+    queue->slots = NULL;
+}
+
+// Producer: returns a slot to fill in, NULL if the ring is full
+// Nothing is visible to the consumer until spsc_push()
+static inline void* spsc_reserve(spsc_t *queue)
+{
+    uint32_t tail = queue->tail;
+
+    if(tail - queue->cached_head > queue->mask)
+    {
+        queue->cached_head = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+        if(tail - queue->cached_head > queue->mask)
+            return NULL;
+    }
+
+    return queue->slots + (size_t)(tail & queue->mask) * queue->slot_size;
+}
+
+static inline void spsc_push(spsc_t *queue)
+{
+    __atomic_store_n(&queue->tail, queue->tail + 1, __ATOMIC_RELEASE);
+}
+
+// Consumer: returns the oldest slot, NULL if the ring is empty
+// The slot stays valid until spsc_pop()
+static inline void* spsc_peek(spsc_t *queue)
+{
+    uint32_t head = queue->head;
+
+    if(head == queue->cached_tail)
+    {
+        queue->cached_tail = __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE);
+        if(head == queue->cached_tail)
+            return NULL;
+    }
+
+    return queue->slots + (size_t)(head & queue->mask) * queue->slot_size;
+}
+
+static inline void spsc_pop(spsc_t *queue)
+{
+    __atomic_store_n(&queue->head, queue->head + 1, __ATOMIC_RELEASE);
+}
+
+#endif
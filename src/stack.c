@@ -0,0 +1,189 @@
+#include<stdlib.h>
+#include<string.h>
+
+#include "wm.h"
+#include "ipc.h"
+#include "stack.h"
+
+// Top to bottom, same as XRestackWindows wants it
+typedef struct
+{
+    Window *windows;
+    int len, capacity;
+} window_list_t;
+
+#define FIXED_MAX 8
+
+static window_list_t applied, desired;
+static struct
+{
+    Window window;
+    stack_layer_t layer;
+} fixed[FIXED_MAX];
+static int fixed_len = 0;
+static bool dirty = false;
+
+static bool reserve(window_list_t *list, int len)
+{
+    if(len <= list->capacity)
+        return true;
+
+    int capacity = list->capacity == 0 ? 16 : list->capacity * 2;
+    while(capacity < len)
+        capacity *= 2;
+
+    Window *windows = realloc(list->windows, capacity * sizeof(Window));
+    if(windows == NULL)
+        return false;
+    list->windows = windows;
+    list->capacity = capacity;
+    return true;
+}
+
+static void append(window_list_t *list, Window window)
+{
+    if(reserve(list, list->len + 1))
+        list->windows[list->len++] = window;
+}
+
+void stack_add(Window window)
+{
+    if(!reserve(&applied, applied.len + 1))
+        return;
+
+    memmove(applied.windows + 1, applied.windows, applied.len * sizeof(Window));
+    applied.windows[0] = window;
+    applied.len++;
+    dirty = true;
+}
+
+void stack_add_fixed(Window window, stack_layer_t layer)
+{
+    if(fixed_len == FIXED_MAX)
+        return;
+
+    fixed[fixed_len].window = window;
+    fixed[fixed_len].layer = layer;
+    fixed_len++;
+    stack_add(window);
+}
+
+// Doesn't change where anything else is, no need to restack
+void stack_remove(Window window)
+{
+    for(int i = 0; i < applied.len; i++)
+    {
+        if(applied.windows[i] != window)
+            continue;
+        memmove(applied.windows + i, applied.windows + i + 1, (applied.len - i - 1) * sizeof(Window));
+        applied.len--;
+        break;
+    }
+
+    for(int i = 0; i < fixed_len; i++)
+    {
+        if(fixed[i].window != window)
+            continue;
+        fixed[i] = fixed[--fixed_len];
+        break;
+    }
+}
+
+void stack_touch(void)
+{
+    dirty = true;
+}
+
+static void build_desired(void)
+{
+    desired.len = 0;
+
+    for(int layer = STACK_LAYERS - 1; layer >= 0; layer--)
+    {
+        for(int i = 0; i < fixed_len; i++)
+            if(fixed[i].layer == (stack_layer_t)layer)
+                append(&desired, fixed[i].window);
+
+        if(layer == STACK_FULLSCREEN && wm.fullscreen != NULL)
+            append(&desired, wm.fullscreen->frame);
+        else if(layer == STACK_FLOATING)
+        {
+            for(client_t *client = wm.mru; client != NULL; client = client->mru_next)
+                if(client->floating && !client->fullscreen)
+                    append(&desired, client->frame);
+        }
+        else if(layer == STACK_TILED)
+        {
+            for(client_t *client = wm.head; client != NULL; client = client->next)
+                if(!client->floating && !client->fullscreen)
+                    append(&desired, client->frame);
+        }
+    }
+}
+
+void stack_flush(void)
+{
+    int first = 0, last = 0, requests = 0;
+
+    if(!dirty)
+        return;
+    dirty = false;
+
+    build_desired();
+    if(desired.len == 0)
+    {
+        applied.len = 0;
+        return;
+    }
+
+    // Everything is added/removed as it's created/destroyed, so this
+    // only happens if something was missed, just send the whole order
+    if(desired.len != applied.len)
+    {
+        LOG("Stack model out of sync(%d/%d windows), restacking everything", desired.len, applied.len);
+        first = 0;
+        last = desired.len - 1;
+    }
+    else
+    {
+        while(first < desired.len && desired.windows[first] == applied.windows[first])
+            first++;
+        if(first == desired.len)
+            return; // Nothing moved
+        last = desired.len - 1;
+        while(desired.windows[last] == applied.windows[last])
+            last--;
+    }
+
+    // XRestackWindows leaves the first window where it is and puts the
+    // rest right under it, so it starts at the last window that's still
+    // in the right spot. If the top one changed it's fine to start with
+    // it anyway: everything of ours that's above it now is in the span
+    // and ends up below it. Nothing gets raised over popups/menus this way
+    if(first > 0)
+        first--;
+
+    if(last > first)
+    {
+        XRestackWindows(wm.dpy, desired.windows + first, last - first + 1);
+        wm.reconfigured = true;
+        requests++;
+    }
+
+    if(reserve(&applied, desired.len))
+    {
+        memcpy(applied.windows, desired.windows, desired.len * sizeof(Window));
+        applied.len = desired.len;
+    }
+
+    ipc_event(IPC_EVENT_STACK, "stack requests %d windows %d", requests, last - first + 1);
+}
+
+void stack_deinit(void)
+{
+    free(applied.windows);
+    free(desired.windows);
+    memset(&applied, 0, sizeof(applied));
+    memset(&desired, 0, sizeof(desired));
+    fixed_len = 0;
+}
@@ -0,0 +1,38 @@
+#ifndef STACK_H
+#define STACK_H
+
+#include<X11/Xlib.h>
+
+#include "wm.h"
+
+// Stacking order of everything the WM puts on the root window
+// Nothing raises windows directly, changes only mark the order dirty
+// and stack_flush() works out the order the layers below ask for,
+// compares it with the order that was last sent and restacks only
+// the span in between that differs, with a single XRestackWindows
+//
+// Layers, bottom to top. Fullscreen goes over the bar since it covers
+// the whole output. Inside a layer tiled clients follow the client list
+// and floating ones the focus history, so the focused one is on top
+typedef enum
+{
+    STACK_DESKTOP = 0,
+    STACK_TILED,
+    STACK_FLOATING,
+    STACK_BAR,
+    STACK_FULLSCREEN,
+    STACK_LAYERS
+} stack_layer_t;
+
+// New windows start out on top of their siblings, that's where the
+// model puts them too. Client frames get their layer from the client,
+// anything else(the bar) has to say which one it's in
+void stack_add(Window window);
+void stack_add_fixed(Window window, stack_layer_t layer);
+void stack_remove(Window window);
+
+void stack_touch(void); // Something that affects the order changed
+void stack_flush(void); // Restacks if needed, once per main loop iteration
+void stack_deinit(void);
+
+#endif
@@ -0,0 +1,210 @@
+#include<time.h>
+#include<X11/Xlib.h>
+#include<X11/Xatom.h>
+#include<X11/extensions/sync.h>
+
+#include "wm.h"
+#include "ewmh.h"
+#include "sync.h"
+
+static bool available = false;
+static int event_base = 0, error_base = 0;
+static Atom protocols_atom = None;
+static int waiting = 0; // Clients that haven't answered yet, most of the time none
+
+static long long now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+static long long value_to_ll(XSyncValue value)
+{
+    return ((long long)XSyncValueHigh32(value) << 32) | XSyncValueLow32(value);
+}
+
+bool sync_init(void)
+{
+    int major = 0, minor = 0;
+
+    if(!XSyncQueryExtension(wm.dpy, &event_base, &error_base)
+            || !XSyncInitialize(wm.dpy, &major, &minor))
+    {
+        LOG("No XSync, resizes aren't paced");
+        return false;
+    }
+
+    protocols_atom = XInternAtom(wm.dpy, "WM_PROTOCOLS", False);
+    available = true;
+    return true;
+}
+
+void sync_deinit(void)
+{
+    for(client_t *client = wm.head; client != NULL; client = client->next)
+        sync_client_remove(client);
+    available = false;
+}
+
+void sync_client_add(client_t *client, XID counter)
+{
+    XSyncAlarmAttributes attributes = {0};
+
+    if(!available || counter == None)
+        return;
+
+    // Fires once the counter reaches the value of the last request,
+    // goes inactive after that until it's pointed at the next one
+    attributes.trigger.counter = counter;
+    attributes.trigger.value_type = XSyncAbsolute;
+    attributes.trigger.test_type = XSyncPositiveComparison;
+    XSyncIntToValue(&attributes.trigger.wait_value, 0);
+    XSyncIntToValue(&attributes.delta, 0);
+    attributes.events = True;
+
+    client->sync_counter = counter;
+    client->sync_alarm = XSyncCreateAlarm(wm.dpy,
+            XSyncCACounter | XSyncCAValueType | XSyncCAValue | XSyncCATestType | XSyncCADelta | XSyncCAEvents,
+            &attributes);
+}
+
+void sync_client_remove(client_t *client)
+{
+    if(client->sync_alarm != None)
+        XSyncDestroyAlarm(wm.dpy, client->sync_alarm);
+    if(client->sync_waiting)
+        waiting--;
+    client->sync_alarm = None;
+    client->sync_counter = None;
+    client->sync_waiting = false;
+}
+
+static void send_request(client_t *client)
+{
+    XSyncAlarmAttributes attributes = {0};
+    XEvent event = {0};
+
+    client->sync_value++;
+
+    event.xclient.type = ClientMessage;
+    event.xclient.window = client->window;
+    event.xclient.message_type = protocols_atom;
+    event.xclient.format = 32;
+    event.xclient.data.l[0] = net_atoms[NET_WM_SYNC_REQUEST];
+    event.xclient.data.l[1] = CurrentTime;
+    event.xclient.data.l[2] = client->sync_value & 0xffffffff;
+    event.xclient.data.l[3] = (client->sync_value >> 32) & 0xffffffff;
+    XSendEvent(wm.dpy, client->window, False, NoEventMask, &event);
+
+    XSyncIntsToValue(&attributes.trigger.wait_value,
+            client->sync_value & 0xffffffff, client->sync_value >> 32);
+    XSyncChangeAlarm(wm.dpy, client->sync_alarm, XSyncCAValue, &attributes);
+
+    if(!client->sync_waiting)
+        waiting++;
+    client->sync_waiting = true;
+    client->sync_sent = now_ms();
+}
+
+bool sync_resize(client_t *client, int width, int height)
+{
+    if(client->sync_alarm == None)
+        return true;
+
+    if(client->sync_waiting)
+    {
+        // Whatever was saved before is out of date now
+        client->sync_width = width;
+        client->sync_height = height;
+        return false;
+    }
+
+    // Has to go out before the ConfigureNotify it's about
+    send_request(client);
+    return true;
+}
+
+// Client painted the last size, or took too long
+static void sync_done(client_t *client)
+{
+    int width = client->sync_width, height = client->sync_height;
+
+    client->sync_waiting = false;
+    waiting--;
+    if(width == 0 || height == 0)
+        return;
+
+    client->sync_width = client->sync_height = 0;
+    send_request(client);
+    XResizeWindow(wm.dpy, client->window, width, height);
+    client->window_width = width;
+    client->window_height = height;
+}
+
+bool sync_event(XEvent *ev)
+{
+    XSyncAlarmNotifyEvent *event = (XSyncAlarmNotifyEvent*)ev;
+
+    if(!available || ev->type != event_base + XSyncAlarmNotify)
+        return false;
+
+    for(client_t *client = wm.head; client != NULL; client = client->next)
+    {
+        long long value = 0;
+
+        if(client->sync_alarm != event->alarm)
+            continue;
+
+        // The alarm also fires right away if the counter is already
+        // past the value, e.g. a client that didn't start at 0
+        value = value_to_ll(event->counter_value);
+        if(value > client->sync_value)
+            client->sync_value = value;
+        if(client->sync_waiting && value >= client->sync_value)
+            sync_done(client);
+        break;
+    }
+    return true;
+}
+
+int sync_timeout(int timeout)
+{
+    long long now = 0;
+
+    if(waiting == 0)
+        return timeout;
+
+    now = now_ms();
+
+    for(client_t *client = wm.head; client != NULL; client = client->next)
+    {
+        int left = 0;
+
+        if(!client->sync_waiting)
+            continue;
+
+        left = client->sync_sent + SYNC_TIMEOUT_MS - now;
+        if(left < 0)
+            left = 0;
+        if(timeout < 0 || left < timeout)
+            timeout = left;
+    }
+    return timeout;
+}
+
+void sync_tick(void)
+{
+    long long now = 0;
+
+    if(waiting == 0)
+        return;
+
+    now = now_ms();
+
+    // Hung or just slow, either way it gets the latest size
+    // and another chance, the layout isn't held up by it forever
+    for(client_t *client = wm.head; client != NULL; client = client->next)
+        if(client->sync_waiting && now - client->sync_sent >= SYNC_TIMEOUT_MS)
+            sync_done(client);
+}
@@ -0,0 +1,37 @@
+#ifndef SYNC_H
+#define SYNC_H
+
+#include<X11/Xlib.h>
+#include<stdbool.h>
+
+#include "wm.h"
+
+// _NET_WM_SYNC_REQUEST, resizes paced to how fast a client can paint
+// Before a resize the client is sent a number, once it has drawn the
+// new size it sets its XSync counter to that number and an alarm on
+// the counter tells us. Until then further resizes aren't sent, only
+// the latest size is kept and goes out with the alarm, so nudging
+// master_weight with key repeat doesn't pile up configures in a slow
+// client. Clients that don't support it are resized right away
+
+bool sync_init(void); // false if there's no XSync, everything is resized right away then
+void sync_deinit(void);
+
+// counter is _NET_WM_SYNC_REQUEST_COUNTER, None if the client doesn't do sync
+void sync_client_add(client_t *client, XID counter);
+void sync_client_remove(client_t *client);
+
+// true if the window can be resized to width x height now, the request
+// has been sent if it does sync. false means the client is still busy
+// with the last one, the size was saved and is applied once it's done
+bool sync_resize(client_t *client, int width, int height);
+
+// Returns true if it was an alarm event
+bool sync_event(XEvent *ev);
+
+// Clients that never answer are only waited for SYNC_TIMEOUT_MS
+#define SYNC_TIMEOUT_MS 250
+int sync_timeout(int timeout); // timeout for poll(), -1 = forever, lowered if a client is being waited for
+void sync_tick(void); // Gives up on clients that took too long
+
+#endif
@@ -0,0 +1,138 @@
+#ifndef WM_H
+#define WM_H
+
+#include<stdio.h>
+#include<stdbool.h>
+#include<X11/Xlib.h>
+#include<X11/Xutil.h>
+
+#define LOG(...)\
+    fprintf(stderr, __VA_ARGS__);\
+    fprintf(stderr, "\n");
+
+// Each window needs a frame/border
+// The client type exists to pair the window with the border
+// And also to create a linked list to traverse the clients
+struct client_t
+{
+    Window window, frame;
+    bool fullscreen; // Window becomes fullscreen when this is set to true
+    bool hidden; // Frame is unmapped by the monocle layout, still managed
+    bool floating; // Not tiled, keeps whatever geometry it asks for
+    unsigned int net_state; // _NET_WM_STATE as written to the window, see ewmh.h
+
+    // Last geometry given to the frame by the layout
+    int x, y, width, height;
+
+    // Where a floating client wants to be, restored after fullscreen
+    int float_x, float_y, float_width, float_height;
+
+    // Size the window inside the frame last got, the window
+    // isn't resized at all if snapping gives the same size again
+    int window_width, window_height;
+
+    // WM_NORMAL_HINTS, fetched when mapped and on PropertyNotify
+    // The window is snapped to these, the frame absorbs the slack
+    int base_width, base_height;
+    int inc_width, inc_height;
+    int min_width, min_height;
+    int max_width, max_height;
+
+    // _NET_WM_SYNC_REQUEST, see sync.h
+    XID sync_counter, sync_alarm; // None if the client doesn't do sync
+    long long sync_value; // Last value the client was asked to set the counter to
+    long long sync_sent; // When, in ms
+    bool sync_waiting; // Hasn't painted the last resize yet
+    int sync_width, sync_height; // Size it gets once it has, 0 if nothing changed since
+
+    struct client_t *next; // Linked list
+    struct client_t *prev;
+
+    // Focus history, most recently focused first, see wm.mru
+    struct client_t *mru_next;
+    struct client_t *mru_prev;
+};
+typedef struct client_t client_t;
+
+typedef enum
+{
+    LAYOUT_TILE = 0, // default_tiling_layout()
+    LAYOUT_MONOCLE,  // monocle_layout()
+} layout_t;
+
+typedef struct
+{
+    client_t *head, *tail; // Linked list
+
+    // Clients are the total amount of windows in the workspace
+    // Masters is the amount of masters(amount of windows on the left side)
+    int clients, masters;
+
+    // master_weight = 0.5 means master window takes up 50% of the screen
+    // 0.75 means it takes up 75% etc
+    // Width is calculated by multiplying the screen width with master_weight
+    float master_weight;
+} workspace_t;
+
+// Window manager info
+// Important often needed variables
+// are stored inside this struct
+typedef struct
+{
+    Display *dpy;
+    Window root;
+    bool running; // WM exits whe this becomes false
+
+//    workspace_t workspaces[10];
+
+    // Keyboard inputs go to the focused client
+    client_t *focus;
+
+    // Focus history, moved to the front in O(1) on every focus change
+    // NOTE: One for the whole WM until there are workspaces
+    client_t *mru;
+
+    // Covers the whole screen, layout is suspended while this is set
+    client_t *fullscreen;
+
+    // NOTE: To be replaced with workspaces
+    client_t *head, *tail;
+    int masters, clients;
+    float master_weight;
+    layout_t layout;
+    bool arrange_pending; // See arrange()
+
+    // Set whenever frames are moved, mapped or restacked
+    // Crossing events with a serial below enter_serial were caused by
+    // that and not by the pointer moving, see handle_enter()
+    bool reconfigured;
+    unsigned long enter_serial;
+} wm_t;
+extern wm_t wm;
+
+// Functions related to tiling windows
+void arrange(void); // Re-tiles once the current batch of events is handled
+void arrange_flush(void);
+void set_layout(layout_t layout);
+void default_tiling_layout(void);
+void monocle_layout(void);
+void focus_next(void);
+void focus_prev(void);
+void focus_last(void); // Alt-Tab, the previously focused client
+void focus_client(client_t *client);
+void focus_flush(void); // Sets input focus and recolors borders, once per main loop iteration
+void update_masters(int change);
+void update_master_weight(float change);
+void set_fullscreen(client_t *client, bool fullscreen);
+
+// General utils functions
+client_t* client_from_frame(Window frame, client_t **ret_prev);
+client_t* client_from_window(Window window, client_t **ret_prev);
+void client_move_resize(client_t *client, int x, int y, int width, int height);
+void client_update_size_hints(client_t *client);
+void client_set_size_hints(client_t *client, const XSizeHints *hints);
+void close_client(client_t *client);
+long frame_event_mask(void); // Depends on config.focus_follows_mouse
+void exec(const char* program);
+
+#endif
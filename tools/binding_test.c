@@ -0,0 +1,107 @@
+// Key bindings with and without shift, pressed through XTest
+//
+//   TILE_WM_CONFIG=./tools/binding_test.conf ... then
+//   DISPLAY=:1 ./bin/binding_test
+//
+// Needs a tile_wm that's already running with tools/binding_test.conf,
+// waits up to 5s for its socket. `./wiz_build test` does all of that in Xvfb.
+// Presses Alt+h(default binding), Alt+Shift+h and Alt+Shift+Tab and checks
+// master_weight moved by what each binding says, a shift+ binding that
+// doesn't fire or fires the unshifted one shows up as the wrong change.
+// Exits with 1 if any of them is off
+
+#include<X11/keysym.h>
+#include<X11/extensions/XTest.h>
+
+#include "common.h"
+
+typedef struct
+{
+    const char *name;
+    KeySym keysym;
+    bool shift;
+    float change; // From config.h/binding_test.conf
+} press_t;
+
+static const press_t presses[] =
+{
+    { "Alt+h", XK_h, false, -0.05f },
+    { "Alt+Shift+h", XK_h, true, +0.2f },
+    { "Alt+Shift+Tab", XK_Tab, true, -0.1f },
+};
+
+// master_weight from GET_LAYOUT, -1 if the WM went away
+static float read_weight(int fd)
+{
+    char reply[IPC_MAX_PAYLOAD + 1];
+    float weight = -1;
+
+    if(ipc_request(fd, IPC_GET_LAYOUT, "", reply) < 0 || sscanf(reply, "%*s masters %*d weight %f", &weight) != 1)
+        return -1;
+    return weight;
+}
+
+// Returns the change of master_weight, 0 if nothing happened within TIMEOUT_NS
+static float press(Display *dpy, int fd, const press_t *p)
+{
+    KeyCode alt = XKeysymToKeycode(dpy, XK_Alt_L), shift = XKeysymToKeycode(dpy, XK_Shift_L);
+    KeyCode key = XKeysymToKeycode(dpy, p->keysym);
+    struct timespec pause = { 0, 1000000 };
+    float before = read_weight(fd), after = before;
+    long long start = 0;
+
+    XTestFakeKeyEvent(dpy, alt, True, CurrentTime);
+    if(p->shift)
+        XTestFakeKeyEvent(dpy, shift, True, CurrentTime);
+    XTestFakeKeyEvent(dpy, key, True, CurrentTime);
+    XTestFakeKeyEvent(dpy, key, False, CurrentTime);
+    if(p->shift)
+        XTestFakeKeyEvent(dpy, shift, False, CurrentTime);
+    XTestFakeKeyEvent(dpy, alt, False, CurrentTime);
+    XFlush(dpy);
+    start = now_ns();
+
+    while(now_ns() - start < TIMEOUT_NS && after == before)
+    {
+        nanosleep(&pause, NULL);
+        after = read_weight(fd);
+    }
+    return after - before;
+}
+
+int main(void)
+{
+    int event = 0, error = 0, major = 0, minor = 0, failed = 0, fd = -1;
+    Display *dpy = XOpenDisplay(NULL);
+
+    if(dpy == NULL)
+    {
+        fprintf(stderr, "Can't open display\n");
+        return 1;
+    }
+    if(!XTestQueryExtension(dpy, &event, &error, &major, &minor))
+    {
+        fprintf(stderr, "XTest isn't available\n");
+        return 1;
+    }
+    fd = ipc_connect(TIMEOUT_NS);
+    if(fd < 0)
+    {
+        fprintf(stderr, "tile_wm isn't running\n");
+        return 1;
+    }
+
+    for(size_t i = 0; i < sizeof(presses) / sizeof(presses[0]); i++)
+    {
+        float change = press(dpy, fd, &presses[i]);
+        // Layout replies only have two decimals
+        bool ok = change > presses[i].change - 0.005f && change < presses[i].change + 0.005f;
+
+        printf("%-14s weight %+.2f, expected %+.2f %s\n", presses[i].name, change, presses[i].change, ok ? "OK" : "FAILED");
+        failed += !ok;
+    }
+
+    close(fd);
+    XCloseDisplay(dpy);
+    return failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,171 @@
+#ifndef TOOLS_COMMON_H
+#define TOOLS_COMMON_H
+
+// Helpers the tools share, IPC client side and test windows
+// Header only like ipc_socket_path(), every tool is a single file
+
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+#include<stdbool.h>
+#include<unistd.h>
+#include<poll.h>
+#include<time.h>
+#include<sys/socket.h>
+#include<sys/un.h>
+#include<X11/Xlib.h>
+#include<X11/Xutil.h>
+
+#include "../src/ipc.h"
+
+// How long anything waits for the WM before giving up
+#define TIMEOUT_NS 5000000000LL
+
+static inline long long now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// qsort() for long long samples
+static inline int compare_ll(const void *a, const void *b)
+{
+    long long x = *(const long long*)a, y = *(const long long*)b;
+    return (x > y) - (x < y);
+}
+
+static inline int count_lines(const char *string)
+{
+    int lines = 0;
+    for(; *string != '\0'; string++)
+        lines += *string == '\n';
+    return lines;
+}
+
+static inline int read_all(int fd, void *buffer, size_t len)
+{
+    size_t done = 0;
+    while(done < len)
+    {
+        ssize_t got = read(fd, (char*)buffer + done, len - done);
+        if(got <= 0)
+            return -1;
+        done += got;
+    }
+    return 0;
+}
+
+// Header and payload in one write, so a message never gets split up
+static inline int ipc_write(int fd, uint32_t type, const char *payload)
+{
+    char buffer[sizeof(ipc_header_t) + IPC_MAX_PAYLOAD];
+    ipc_header_t header = { .length = strlen(payload), .type = type };
+
+    if(header.length > IPC_MAX_PAYLOAD)
+        return -1;
+    memcpy(buffer, &header, sizeof(header));
+    memcpy(buffer + sizeof(header), payload, header.length);
+    return write(fd, buffer, sizeof(header) + header.length) == (ssize_t)(sizeof(header) + header.length) ? 0 : -1;
+}
+
+// Reads the next message into reply(IPC_MAX_PAYLOAD + 1 bytes), NULL terminated
+// Returns the payload length, -1 if the WM went away. type can be NULL
+static inline int ipc_read(int fd, uint32_t *type, char *reply)
+{
+    ipc_header_t header;
+
+    if(read_all(fd, &header, sizeof(header)) < 0 || header.length > IPC_MAX_PAYLOAD)
+        return -1;
+    if(read_all(fd, reply, header.length) < 0)
+        return -1;
+    reply[header.length] = '\0';
+    if(type != NULL)
+        *type = header.type;
+    return header.length;
+}
+
+// Sends a request and returns the payload length of its reply, -1 if the WM went away
+static inline int ipc_request(int fd, uint32_t type, const char *payload, char *reply)
+{
+    if(ipc_write(fd, type, payload) < 0)
+        return -1;
+    return ipc_read(fd, NULL, reply);
+}
+
+// Keeps trying for wait_ns if the socket isn't there yet(WM still starting), -1 if it never is
+static inline int ipc_connect(long long wait_ns)
+{
+    struct sockaddr_un address = { .sun_family = AF_UNIX };
+    long long start = now_ns();
+    struct timespec pause = { 0, 10000000 };
+
+    ipc_socket_path(address.sun_path, sizeof(address.sun_path));
+    for(;;)
+    {
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if(fd >= 0 && connect(fd, (struct sockaddr*)&address, sizeof(address)) == 0)
+            return fd;
+        if(fd >= 0)
+            close(fd);
+        if(now_ns() - start >= wait_ns)
+            return -1;
+        nanosleep(&pause, NULL);
+    }
+}
+
+// 200x100 window that takes WM_DELETE_WINDOW and gets StructureNotify
+// res_class can be NULL, rules match on it, see src/rules.h
+static inline Window make_window(Display *dpy, Atom delete_atom, const char *res_name, const char *res_class)
+{
+    Window window = XCreateSimpleWindow(dpy, DefaultRootWindow(dpy), 0, 0, 200, 100, 0, 0, 0xffffff);
+
+    if(res_class != NULL)
+    {
+        XClassHint hint = { .res_name = (char*)res_name, .res_class = (char*)res_class };
+        XSetClassHint(dpy, window, &hint);
+    }
+    XSetWMProtocols(dpy, window, &delete_atom, 1);
+    XSelectInput(dpy, window, StructureNotifyMask);
+    return window;
+}
+
+// Drains the queue, windows the WM asks to close get destroyed like a
+// real client would. true once `window` got a `type` event, a
+// ClientMessage counts once the WM asked `window` to close
+static inline bool handle_events(Display *dpy, Atom delete_atom, Window window, int type)
+{
+    bool seen = false;
+    XEvent ev;
+
+    while(XPending(dpy) > 0)
+    {
+        XNextEvent(dpy, &ev);
+        if(ev.type == ClientMessage && (Atom)ev.xclient.data.l[0] == delete_atom)
+        {
+            XDestroyWindow(dpy, ev.xclient.window);
+            seen |= type == ClientMessage && ev.xclient.window == window;
+        }
+        else if(ev.type == type && ev.xany.window == window)
+            seen = true;
+    }
+    return seen;
+}
+
+// ns until `window` got a `type` event, -1 after TIMEOUT_NS
+static inline long long wait_for(Display *dpy, Atom delete_atom, Window window, int type)
+{
+    struct pollfd fd = { .fd = ConnectionNumber(dpy), .events = POLLIN };
+    long long start = now_ns();
+
+    XFlush(dpy);
+    while(now_ns() - start < TIMEOUT_NS)
+    {
+        if(handle_events(dpy, delete_atom, window, type))
+            return now_ns() - start;
+        poll(&fd, 1, 100);
+    }
+    return -1;
+}
+
+#endif
@@ -0,0 +1,219 @@
+// Key-to-action latency while the WM is flooded with map/destroy or IPC traffic
+//
+// Run it against a running tile_wm, e.g. inside Xephyr:
+//   DISPLAY=:1 ./bin/input_bench [windows per round] [probes] [ipc clients]
+//
+// Alt+l/Alt+h get pressed through XTest and the time until master_weight
+// changes in the shared memory snapshot is the latency of that key.
+// That's measured idle, while a child process maps and destroys
+// windows as fast as it can, and while IPC clients hammer the socket
+// with queries and status updates next to a subscriber that never
+// reads anything. Keys that never get a reaction(5s) are counted as lost.
+//
+// Needs the default bindings for Alt+h/Alt+l and libXtst
+
+#include<fcntl.h>
+#include<signal.h>
+#include<sys/mman.h>
+#include<sys/wait.h>
+#include<X11/keysym.h>
+#include<X11/extensions/XTest.h>
+
+#include "../src/snapshot.h"
+#include "common.h"
+
+#define LOST_AFTER_NS TIMEOUT_NS
+
+// Never returns, gets killed by the parent
+static void storm(int windows)
+{
+    Display *dpy = XOpenDisplay(NULL);
+    Window *list = calloc(windows, sizeof(Window));
+
+    if(dpy == NULL || list == NULL)
+        _exit(1);
+
+    for(;;)
+    {
+        for(int i = 0; i < windows; i++)
+        {
+            list[i] = XCreateSimpleWindow(dpy, DefaultRootWindow(dpy), 0, 0, 100, 100, 0, 0, 0);
+            XMapWindow(dpy, list[i]);
+        }
+        XFlush(dpy);
+
+        for(int i = 0; i < windows; i++)
+            XDestroyWindow(dpy, list[i]);
+        XSync(dpy, False); // Don't let the request buffer grow forever
+    }
+}
+
+// Never returns, gets killed by the parent
+static void ipc_load(int reader)
+{
+    char buffer[IPC_MAX_PAYLOAD + sizeof(ipc_header_t)];
+    int fd = ipc_connect(0);
+
+    if(fd < 0)
+        _exit(1);
+
+    // Subscribes and then never reads, the WM has to drop it
+    if(reader == 0)
+    {
+        if(ipc_write(fd, IPC_SUBSCRIBE, "focus,layout,map,frame") < 0)
+            _exit(1);
+        for(;;)
+            pause();
+    }
+
+    for(int i = 0;; i++)
+    {
+        if(ipc_write(fd, IPC_GET_CLIENTS, "") < 0 || read(fd, buffer, sizeof(buffer)) <= 0)
+            _exit(1);
+
+        snprintf(buffer, sizeof(buffer), "status load %d", i);
+        if(ipc_write(fd, IPC_COMMAND, buffer) < 0 || read(fd, buffer, sizeof(buffer)) <= 0)
+            _exit(1);
+    }
+}
+
+static float read_weight(const snapshot_t *shared)
+{
+    snapshot_t copy;
+    if(!snapshot_read(shared, &copy))
+        return -1.0f;
+    return copy.master_weight;
+}
+
+// Returns ns until the WM reacted, -1 if it never did
+static long long probe(Display *dpy, const snapshot_t *shared, KeyCode alt, KeyCode key)
+{
+    float before = read_weight(shared);
+    struct timespec pause = { 0, 20000 };
+    long long start = 0;
+
+    XTestFakeKeyEvent(dpy, alt, True, CurrentTime);
+    XTestFakeKeyEvent(dpy, key, True, CurrentTime);
+    XTestFakeKeyEvent(dpy, key, False, CurrentTime);
+    XTestFakeKeyEvent(dpy, alt, False, CurrentTime);
+    XFlush(dpy);
+    start = now_ns();
+
+    while(now_ns() - start < LOST_AFTER_NS)
+    {
+        if(read_weight(shared) != before)
+            return now_ns() - start;
+        nanosleep(&pause, NULL);
+    }
+    return -1;
+}
+
+static void run(Display *dpy, const snapshot_t *shared, int probes, const char *name)
+{
+    KeyCode alt = XKeysymToKeycode(dpy, XK_Alt_L);
+    KeyCode keys[2] = { XKeysymToKeycode(dpy, XK_l), XKeysymToKeycode(dpy, XK_h) };
+    long long *samples = calloc(probes, sizeof(long long));
+    struct timespec gap = { 0, 10000000 };
+    int len = 0, lost = 0;
+
+    if(samples == NULL)
+        return;
+
+    for(int i = 0; i < probes; i++)
+    {
+        long long ns = probe(dpy, shared, alt, keys[i % 2]);
+        if(ns < 0)
+            lost++;
+        else
+            samples[len++] = ns;
+        nanosleep(&gap, NULL);
+    }
+
+    qsort(samples, len, sizeof(long long), compare_ll);
+    if(len > 0)
+        printf("%-8s min %8.3fms  median %8.3fms  p99 %8.3fms  max %8.3fms  lost %d/%d\n", name,
+                samples[0] / 1e6, samples[len / 2] / 1e6,
+                samples[(len * 99) / 100 < len ? (len * 99) / 100 : len - 1] / 1e6,
+                samples[len - 1] / 1e6, lost, probes);
+    else
+        printf("%-8s lost %d/%d\n", name, lost, probes);
+    free(samples);
+}
+
+int main(int argc, char **argv)
+{
+    int windows = argc > 1 ? atoi(argv[1]) : 200;
+    int probes = argc > 2 ? atoi(argv[2]) : 100;
+    int ipc_clients = argc > 3 ? atoi(argv[3]) : 8;
+    pid_t loaders[64];
+    int event = 0, error = 0, major = 0, minor = 0;
+    char path[256];
+    Display *dpy = NULL;
+    snapshot_t *shared = NULL;
+    pid_t child = 0;
+    int fd = -1;
+
+    if(windows <= 0 || probes <= 0 || ipc_clients <= 0 || ipc_clients > 64)
+    {
+        fprintf(stderr, "usage: %s [windows per round] [probes] [ipc clients, up to 64]\n", argv[0]);
+        return 1;
+    }
+
+    dpy = XOpenDisplay(NULL);
+    if(dpy == NULL)
+    {
+        fprintf(stderr, "Can't open display\n");
+        return 1;
+    }
+    if(!XTestQueryExtension(dpy, &event, &error, &major, &minor))
+    {
+        fprintf(stderr, "XTest isn't available\n");
+        return 1;
+    }
+
+    snapshot_path(path, sizeof(path));
+    fd = open(path, O_RDONLY);
+    if(fd < 0)
+    {
+        perror(path);
+        return 1;
+    }
+    shared = mmap(NULL, sizeof(snapshot_t), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(shared == MAP_FAILED || read_weight(shared) < 0.0f)
+    {
+        fprintf(stderr, "%s isn't a tile_wm snapshot\n", path);
+        return 1;
+    }
+
+    run(dpy, shared, probes, "idle");
+
+    child = fork();
+    if(child == 0)
+        storm(windows);
+    sleep(1); // Let the storm get going
+
+    run(dpy, shared, probes, "storm");
+
+    kill(child, SIGKILL);
+    waitpid(child, NULL, 0);
+
+    for(int i = 0; i < ipc_clients; i++)
+    {
+        loaders[i] = fork();
+        if(loaders[i] == 0)
+            ipc_load(i);
+    }
+    sleep(1);
+
+    run(dpy, shared, probes, "ipc");
+
+    for(int i = 0; i < ipc_clients; i++)
+    {
+        kill(loaders[i], SIGKILL);
+        waitpid(loaders[i], NULL, 0);
+    }
+    munmap(shared, sizeof(snapshot_t));
+    XCloseDisplay(dpy);
+    return 0;
+}
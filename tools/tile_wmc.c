@@ -0,0 +1,104 @@
+// Tiny command line client for the tile_wm IPC socket
+//
+// tile_wmc focus next          - run a command
+// tile_wmc clients             - list clients and their geometry
+// tile_wmc layout              - print masters/master_weight
+// tile_wmc subscribe focus,map - print events until the WM goes away
+// tile_wmc state               - print the shared memory snapshot, doesn't touch the socket
+
+#include<fcntl.h>
+#include<sys/mman.h>
+
+#include "../src/snapshot.h"
+#include "common.h"
+
+// Prints the payload of the next message, -1 once the WM goes away
+static int print_message(int fd)
+{
+    char payload[IPC_MAX_PAYLOAD + 1];
+    int len = ipc_read(fd, NULL, payload);
+
+    if(len < 0)
+        return -1;
+    fputs(payload, stdout);
+    if(len > 0 && payload[len-1] != '\n')
+        fputc('\n', stdout);
+    fflush(stdout);
+    return 0; // NOTE: Not the type, events have the top bit set
+}
+
+static int print_snapshot(void)
+{
+    char path[256];
+    snapshot_t *shared = NULL, state;
+    int fd = -1;
+
+    snapshot_path(path, sizeof(path));
+    fd = open(path, O_RDONLY);
+    if(fd < 0)
+    {
+        perror(path);
+        return 1;
+    }
+    shared = mmap(NULL, sizeof(snapshot_t), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(shared == MAP_FAILED || !snapshot_read(shared, &state))
+        return 1;
+
+    printf("seq %u focus 0x%llx layout %d masters %d weight %.2f clients %d\n",
+            state.seq, (unsigned long long)state.focus, state.layout,
+            state.masters, state.master_weight, state.clients);
+    for(int i = 0; i < state.len; i++)
+    {
+        printf("0x%llx 0x%llx %d %d %d %d\n",
+                (unsigned long long)state.client[i].window, (unsigned long long)state.client[i].frame,
+                state.client[i].x, state.client[i].y, state.client[i].width, state.client[i].height);
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    struct sockaddr_un address = { .sun_family = AF_UNIX };
+    char payload[IPC_MAX_PAYLOAD] = {0};
+    uint32_t type = IPC_COMMAND;
+    size_t len = 0;
+    int fd = -1;
+
+    if(argc < 2)
+    {
+        fprintf(stderr, "usage: %s <command...> | clients | layout | subscribe <events> | state\n", argv[0]);
+        return 1;
+    }
+    else if(strcmp(argv[1], "state") == 0)
+        return print_snapshot();
+
+    if(strcmp(argv[1], "clients") == 0)
+        type = IPC_GET_CLIENTS;
+    else if(strcmp(argv[1], "layout") == 0)
+        type = IPC_GET_LAYOUT;
+    else if(strcmp(argv[1], "subscribe") == 0)
+        type = IPC_SUBSCRIBE;
+
+    // Everything after the message type is joined into the payload
+    for(int i = type == IPC_COMMAND ? 1 : 2; i < argc && len < sizeof(payload); i++)
+        len += snprintf(payload + len, sizeof(payload) - len, "%s%s", i > 1 && len > 0 ? " " : "", argv[i]);
+
+    fd = ipc_connect(0);
+    if(fd < 0)
+    {
+        ipc_socket_path(address.sun_path, sizeof(address.sun_path));
+        perror(address.sun_path);
+        return 1;
+    }
+
+    if(ipc_write(fd, type, payload) < 0 || print_message(fd) < 0)
+        return 1;
+
+    // Reply to subscribe has been printed, now just keep printing events
+    while(type == IPC_SUBSCRIBE && print_message(fd) >= 0)
+        ;
+
+    close(fd);
+    return 0;
+}
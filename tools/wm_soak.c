@@ -0,0 +1,318 @@
+// Client churn soak test, looks for anything the WM leaks per client
+//
+//   DISPLAY=:1 ./bin/wm_soak [cycles] [samples]
+//
+// Every cycle maps one window and gets rid of it again, taking turns
+// between destroying it while mapped, unmapping it(withdraw) and then
+// destroying it, and closing it through the WM's "close". Every 16th
+// cycle also has the WM spawn `true`. Needs a tile_wm that's already
+// running, waits up to 5s for its socket. samples times over the run it
+// waits for the WM to be back to no clients and records:
+//   clients - GET_CLIENTS, live client_t
+//   windows - windows the WM's X connection owns(XRes), frames included
+//   xres    - every resource the WM's X connection owns
+//   fds     - /proc/<wm>/fd
+//   zombies - children of the WM nobody waited for
+//   rss     - only printed, the heap is the asan profile's job
+// Everything has to be back to where it was after the first quarter of
+// the run by the end, otherwise it exits with 1
+// The WM has to be on the same machine, its pid comes from XRes
+
+#include<dirent.h>
+#include<X11/extensions/XRes.h>
+
+#include "common.h"
+
+enum { CLIENTS, WINDOWS, XRES, FDS, ZOMBIES, RSS, METRICS };
+static const char *names[METRICS] = { "clients", "windows", "xres", "fds", "zombies", "rss(kB)" };
+// How much higher than the baseline a metric may end up, -1 = not checked
+// A bit of slack for the xres ones, the WM might not have sent the
+// XDestroyWindow for the last frame by the time they're queried
+static const long slack[METRICS] = { 0, 2, 2, 2, 1, -1 };
+
+static Atom delete_atom;
+
+// The WM's X connection, found through the frame our window got put in
+static XID wm_client_base(Display *dpy, Window frame)
+{
+    XResClient *clients = NULL;
+    XID base = None;
+    int len = 0;
+
+    if(!XResQueryClients(dpy, &len, &clients))
+        return None;
+    for(int i = 0; i < len; i++)
+        if((frame & ~clients[i].resource_mask) == clients[i].resource_base)
+            base = clients[i].resource_base;
+    XFree(clients);
+    return base;
+}
+
+static pid_t wm_client_pid(Display *dpy, XID base)
+{
+    XResClientIdSpec spec = { .client = base, .mask = XRES_CLIENT_ID_PID_MASK };
+    XResClientIdValue *values = NULL;
+    long len = 0;
+    pid_t pid = -1;
+
+    if(XResQueryClientIds(dpy, 1, &spec, &len, &values) != Success)
+        return -1;
+    for(long i = 0; i < len && pid < 0; i++)
+        pid = XResGetClientPid(&values[i]);
+    XResClientIdsDestroy(len, values);
+    return pid;
+}
+
+static void query_xres(Display *dpy, XID base, long *windows, long *total)
+{
+    XResType *types = NULL;
+    Atom window_atom = XInternAtom(dpy, "WINDOW", False);
+    int len = 0;
+
+    *windows = *total = -1;
+    if(!XResQueryClientResources(dpy, base, &len, &types))
+        return;
+    *windows = *total = 0;
+    for(int i = 0; i < len; i++)
+    {
+        if(types[i].resource_type == window_atom)
+            *windows = types[i].count;
+        *total += types[i].count;
+    }
+    XFree(types);
+}
+
+static long count_fds(pid_t pid)
+{
+    char path[64];
+    struct dirent *entry = NULL;
+    DIR *dir = NULL;
+    long fds = 0;
+
+    snprintf(path, sizeof(path), "/proc/%d/fd", pid);
+    if((dir = opendir(path)) == NULL)
+        return -1;
+    while((entry = readdir(dir)) != NULL)
+        fds += entry->d_name[0] != '.';
+    closedir(dir);
+    return fds;
+}
+
+static long count_zombies(pid_t parent)
+{
+    char path[300], state = 0;
+    struct dirent *entry = NULL;
+    DIR *dir = opendir("/proc");
+    long zombies = 0;
+    int ppid = 0;
+
+    if(dir == NULL)
+        return -1;
+    while((entry = readdir(dir)) != NULL)
+    {
+        FILE *fp = NULL;
+
+        if(entry->d_name[0] < '0' || entry->d_name[0] > '9')
+            continue;
+        snprintf(path, sizeof(path), "/proc/%s/stat", entry->d_name);
+        if((fp = fopen(path, "r")) == NULL)
+            continue; // Already gone
+        // pid (comm) state ppid, comm can have spaces in it
+        if(fscanf(fp, "%*d (%*[^)]) %c %d", &state, &ppid) == 2 && ppid == parent && state == 'Z')
+            zombies++;
+        fclose(fp);
+    }
+    closedir(dir);
+    return zombies;
+}
+
+static long rss_kb(pid_t pid)
+{
+    char path[64];
+    long pages = -1;
+    FILE *fp = NULL;
+
+    snprintf(path, sizeof(path), "/proc/%d/statm", pid);
+    if((fp = fopen(path, "r")) == NULL)
+        return -1;
+    if(fscanf(fp, "%*d %ld", &pages) != 1)
+        pages = -1;
+    fclose(fp);
+    return pages < 0 ? -1 : pages * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+// One map and the WM letting go of it again, false if the WM stopped answering
+static bool cycle(Display *dpy, int fd, long i, Window *frame)
+{
+    Window window = make_window(dpy, delete_atom, NULL, NULL), root = None, *children = NULL;
+    char reply[IPC_MAX_PAYLOAD + 1], command[64];
+    unsigned int len = 0;
+
+    XMapWindow(dpy, window);
+    if(wait_for(dpy, delete_atom, window, ReparentNotify) < 0)
+        return false;
+    if(frame != NULL && XQueryTree(dpy, window, &root, frame, &children, &len))
+        XFree(children);
+
+    if(i % 16 == 0 && ipc_request(fd, IPC_COMMAND, "spawn true", reply) < 0)
+        return false;
+
+    switch(i % 3)
+    {
+        case 0:
+            XDestroyWindow(dpy, window);
+            XFlush(dpy);
+            return true;
+        case 1:
+            // Withdrawn, the WM has to hand it back to the root
+            XUnmapWindow(dpy, window);
+            if(wait_for(dpy, delete_atom, window, ReparentNotify) < 0)
+                return false;
+            XDestroyWindow(dpy, window);
+            XFlush(dpy);
+            return true;
+        default:
+            snprintf(command, sizeof(command), "focus %lu", window);
+            if(ipc_request(fd, IPC_COMMAND, command, reply) < 0
+                    || ipc_request(fd, IPC_COMMAND, "close", reply) < 0)
+                return false;
+            return wait_for(dpy, delete_atom, window, ClientMessage) >= 0;
+    }
+}
+
+// Waits for the WM to be back to `clients` clients
+static bool settle(Display *dpy, int fd, int clients)
+{
+    struct timespec pause = { 0, 1000000 };
+    char reply[IPC_MAX_PAYLOAD + 1];
+    long long start = now_ns();
+
+    while(now_ns() - start < TIMEOUT_NS)
+    {
+        handle_events(dpy, delete_atom, None, 0);
+        if(ipc_request(fd, IPC_GET_CLIENTS, "", reply) < 0)
+            return false;
+        if(count_lines(reply) <= clients)
+            return true;
+        nanosleep(&pause, NULL);
+    }
+    return true; // Leftover clients show up in the numbers
+}
+
+static void sample(Display *dpy, int fd, XID base, pid_t pid, long *out)
+{
+    char reply[IPC_MAX_PAYLOAD + 1];
+
+    out[CLIENTS] = ipc_request(fd, IPC_GET_CLIENTS, "", reply) < 0 ? -1 : count_lines(reply);
+    XSync(dpy, False);
+    query_xres(dpy, base, &out[WINDOWS], &out[XRES]);
+    out[FDS] = count_fds(pid);
+    out[ZOMBIES] = count_zombies(pid);
+    out[RSS] = rss_kb(pid);
+}
+
+int main(int argc, char **argv)
+{
+    long cycles = argc > 1 ? atol(argv[1]) : 1000000;
+    int samples = argc > 2 ? atoi(argv[2]) : 100;
+    char reply[IPC_MAX_PAYLOAD + 1];
+    long *history = NULL, every = 0;
+    int taken = 0, baseline = 0, event_base = 0, error_base = 0;
+    Window frame = None;
+    Display *dpy = NULL;
+    long long start = 0;
+    bool ok = true;
+    XID base = None;
+    pid_t pid = -1;
+    int fd = -1;
+
+    if(cycles <= 0 || samples < 4 || cycles < samples)
+    {
+        fprintf(stderr, "usage: %s [cycles] [samples >= 4]\n", argv[0]);
+        return 1;
+    }
+    every = cycles / samples;
+
+    dpy = XOpenDisplay(NULL);
+    if(dpy == NULL)
+    {
+        fprintf(stderr, "Can't open display\n");
+        return 1;
+    }
+    if(!XResQueryExtension(dpy, &event_base, &error_base))
+    {
+        fprintf(stderr, "No XRes extension\n");
+        return 1;
+    }
+    delete_atom = XInternAtom(dpy, "WM_DELETE_WINDOW", False);
+
+    fd = ipc_connect(TIMEOUT_NS);
+    if(fd < 0)
+    {
+        fprintf(stderr, "tile_wm isn't running\n");
+        return 1;
+    }
+    if(ipc_request(fd, IPC_GET_CLIENTS, "", reply) < 0)
+        return 1;
+    baseline = count_lines(reply);
+
+    // First cycle is only there to find the WM
+    if(!cycle(dpy, fd, 0, &frame) || (base = wm_client_base(dpy, frame)) == None
+            || (pid = wm_client_pid(dpy, base)) < 0)
+    {
+        fprintf(stderr, "Can't find the WM's X connection/pid\n");
+        return 1;
+    }
+
+    history = calloc((size_t)samples * METRICS, sizeof(long));
+    if(history == NULL)
+        return 1;
+
+    printf("%10s", "cycle");
+    for(int m = 0; m < METRICS; m++)
+        printf("%10s", names[m]);
+    printf("\n");
+
+    start = now_ns();
+    for(long i = 1; i <= cycles && taken < samples; i++)
+    {
+        long *row = history + taken * METRICS;
+
+        if(!cycle(dpy, fd, i, NULL))
+        {
+            fprintf(stderr, "WM stopped responding at cycle %ld\n", i);
+            return 1;
+        }
+        if(i % every != 0)
+            continue;
+
+        if(!settle(dpy, fd, baseline))
+            return 1;
+        sample(dpy, fd, base, pid, row);
+        taken++;
+
+        printf("%10ld", i);
+        for(int m = 0; m < METRICS; m++)
+            printf("%10ld", row[m]);
+        printf("\n");
+        fflush(stdout);
+    }
+    printf("%ld cycles in %.1fs\n", cycles, (now_ns() - start) / 1e9);
+
+    // Whatever the WM caches is allocated by then
+    for(int m = 0; m < METRICS; m++)
+    {
+        long first = history[(taken / 4) * METRICS + m], last = history[(taken - 1) * METRICS + m];
+
+        if(slack[m] < 0 || last <= first + slack[m])
+            continue;
+        fprintf(stderr, "%s went from %ld to %ld\n", names[m], first, last);
+        ok = false;
+    }
+    printf("%s\n", ok ? "OK" : "LEAKING");
+
+    free(history);
+    close(fd);
+    XCloseDisplay(dpy);
+    return ok ? 0 : 1;
+}
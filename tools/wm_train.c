@@ -0,0 +1,166 @@
+// Scripted workload, used as PGO training run and for handler latency numbers
+//
+//   DISPLAY=:1 ./bin/wm_train [rounds] [windows] [result file]
+//
+// Every round maps a bunch of windows, runs focus/layout/master commands
+// over IPC and closes everything again, half through the WM's "close"
+// and half by destroying the windows. Needs a tile_wm that's already
+// running, waits up to 5s for its socket. Prints median/p99 of:
+//   map     - XMapWindow until the WM has reparented the window
+//   command - IPC command + GET_LAYOUT until the layout comes back, the X
+//             thread handles both in order so that's the command's latency
+//   close   - closing all windows until GET_CLIENTS is back to where it started,
+//             the "close" half includes the WM_DELETE_WINDOW round trip through us
+// The three medians(ns) get written to the result file, see wiz_build pgo
+
+#include "common.h"
+
+static const char *commands[] =
+{
+    "focus next", "focus next", "focus prev", "focus last",
+    "masters +1", "weight +0.05", "masters -1", "weight -0.05",
+    "layout toggle", "focus next", "layout toggle",
+    "fullscreen", "fullscreen",
+};
+#define COMMANDS (sizeof(commands) / sizeof(commands[0]))
+
+static Atom delete_atom;
+
+static void print_stats(const char *name, long long *samples, int len)
+{
+    qsort(samples, len, sizeof(long long), compare_ll);
+    printf("%-8s median %8.3fms  p99 %8.3fms  max %8.3fms  (%d samples)\n", name,
+            samples[len / 2] / 1e6, samples[(len * 99) / 100] / 1e6, samples[len - 1] / 1e6, len);
+}
+
+int main(int argc, char **argv)
+{
+    int rounds = argc > 1 ? atoi(argv[1]) : 20;
+    int windows = argc > 2 ? atoi(argv[2]) : 8;
+    const char *result_path = argc > 3 ? argv[3] : NULL;
+    char reply[IPC_MAX_PAYLOAD + 1], command[64];
+    long long *maps = NULL, *runs = NULL, *closes = NULL;
+    int map_len = 0, run_len = 0, close_len = 0, baseline = 0;
+    Window *list = NULL;
+    Display *dpy = NULL;
+    int fd = -1;
+
+    if(rounds <= 0 || windows <= 0)
+    {
+        fprintf(stderr, "usage: %s [rounds] [windows] [result file]\n", argv[0]);
+        return 1;
+    }
+
+    dpy = XOpenDisplay(NULL);
+    if(dpy == NULL)
+    {
+        fprintf(stderr, "Can't open display\n");
+        return 1;
+    }
+    delete_atom = XInternAtom(dpy, "WM_DELETE_WINDOW", False);
+
+    fd = ipc_connect(TIMEOUT_NS);
+    if(fd < 0)
+    {
+        fprintf(stderr, "tile_wm isn't running\n");
+        return 1;
+    }
+    if(ipc_request(fd, IPC_GET_CLIENTS, "", reply) < 0)
+        return 1;
+    baseline = count_lines(reply);
+
+    maps = calloc(rounds * windows, sizeof(long long));
+    runs = calloc(rounds * COMMANDS, sizeof(long long));
+    closes = calloc(rounds, sizeof(long long));
+    list = calloc(windows, sizeof(Window));
+    if(maps == NULL || runs == NULL || closes == NULL || list == NULL)
+        return 1;
+
+    for(int round = 0; round < rounds; round++)
+    {
+        long long start = 0;
+
+        for(int i = 0; i < windows; i++)
+        {
+            long long ns = 0;
+
+            list[i] = make_window(dpy, delete_atom, "wm_train", i % 3 == 0 ? "Dialog" : "Train");
+            XMapWindow(dpy, list[i]);
+            ns = wait_for(dpy, delete_atom, list[i], ReparentNotify);
+            if(ns < 0)
+            {
+                fprintf(stderr, "Window %d never got mapped\n", i);
+                return 1;
+            }
+            maps[map_len++] = ns;
+        }
+
+        for(size_t i = 0; i < COMMANDS; i++)
+        {
+            start = now_ns();
+            if(ipc_request(fd, IPC_COMMAND, commands[i], reply) < 0
+                    || ipc_request(fd, IPC_GET_LAYOUT, "", reply) < 0)
+                return 1;
+            runs[run_len++] = now_ns() - start;
+            handle_events(dpy, delete_atom, None, 0);
+        }
+
+        start = now_ns();
+        for(int i = 0; i < windows; i++)
+        {
+            if(i % 2 == 1)
+            {
+                XDestroyWindow(dpy, list[i]);
+                continue;
+            }
+            snprintf(command, sizeof(command), "focus %lu", list[i]);
+            if(ipc_request(fd, IPC_COMMAND, command, reply) < 0
+                    || ipc_request(fd, IPC_COMMAND, "close", reply) < 0)
+                return 1;
+        }
+        XFlush(dpy);
+
+        // The windows list WM_DELETE_WINDOW, so "close" only sends that and
+        // they get destroyed in here, like a real client would do it
+        for(;;)
+        {
+            struct timespec pause = { 0, 100000 };
+            handle_events(dpy, delete_atom, None, 0);
+            if(ipc_request(fd, IPC_GET_CLIENTS, "", reply) < 0)
+                return 1;
+            if(count_lines(reply) <= baseline)
+                break;
+            if(now_ns() - start > TIMEOUT_NS)
+            {
+                fprintf(stderr, "Windows never got closed\n");
+                return 1;
+            }
+            nanosleep(&pause, NULL);
+        }
+        closes[close_len++] = now_ns() - start;
+    }
+
+    print_stats("map", maps, map_len);
+    print_stats("command", runs, run_len);
+    print_stats("close", closes, close_len);
+
+    if(result_path != NULL)
+    {
+        FILE *fp = fopen(result_path, "w");
+        if(fp == NULL)
+        {
+            perror(result_path);
+            return 1;
+        }
+        fprintf(fp, "%lld %lld %lld\n", maps[map_len / 2], runs[run_len / 2], closes[close_len / 2]);
+        fclose(fp);
+    }
+
+    free(list);
+    free(closes);
+    free(runs);
+    free(maps);
+    close(fd);
+    XCloseDisplay(dpy);
+    return 0;
+}
@@ -1,42 +1,415 @@
-
 #define COMPILER "clang"
 
-#define DEBUG_FLAGS "-g", "-Wall", "-Wextra", "-lX11", "-I", "./lib/"
+#define CFLAGS "-Wall", "-Wextra", "-pthread", "-I", "./lib/"
+#define LIBS "-lX11", "-lXext", "-lX11-xcb", "-lxcb", "-lXcomposite", "-lXdamage", "-lXfixes", "-lXrender"
+#define DEBUG_FLAGS "-g", CFLAGS, LIBS
 
-#define MAIN_SRC "./src/main.c"
+#define SRC_DIR "./src/"
+#define OBJ_DIR "./bin/obj/"
 #define OUTPUT "./bin/tile_wm"
+#define CLIENT_SRC "./tools/tile_wmc.c"
+#define CLIENT_DEPS OBJ_DIR "tile_wmc.d"
+#define CLIENT_OUTPUT "./bin/tile_wmc"
+#define BENCH_SRC "./tools/input_bench.c"
+#define BENCH_DEPS OBJ_DIR "input_bench.d"
+#define BENCH_OUTPUT "./bin/input_bench"
+
+// PGO training, see train()
+#define TRAIN_SRC "./tools/wm_train.c"
+#define TRAIN_DEPS OBJ_DIR "wm_train.d"
+#define TRAIN_OUTPUT "./bin/wm_train"
+#define TRAIN_DISPLAY_NUMBER "77"
+#define PGO_DIR "./bin/pgo/"
+#define PROFILE_RAW PGO_DIR "tile_wm.profraw"
+#define PROFILE_DATA PGO_DIR "tile_wm.profdata"
+
+// Client churn against the WM in Xvfb, see soak()
+#define SOAK_SRC "./tools/wm_soak.c"
+#define SOAK_DEPS OBJ_DIR "wm_soak.d"
+#define SOAK_OUTPUT "./bin/wm_soak"
 
+// Shift and plain key bindings pressed through XTest in Xvfb, see test()
+#define BINDING_TEST_SRC "./tools/binding_test.c"
+#define BINDING_TEST_DEPS OBJ_DIR "binding_test.d"
+#define BINDING_TEST_OUTPUT "./bin/binding_test"
+#define BINDING_TEST_CONFIG "./tools/binding_test.conf"
+
+#include<signal.h>
 #include "./wiz_build.h"
 
-int main(int argc, char** argv)
+// ./wiz_build [profile] [run|gdb|val|startx|bench|soak|test]
+//   debug   - default, -g and nothing else
+//   release - -O2 and LTO
+//   asan    - address + undefined behaviour sanitizers
+//   pgo     - release, instrumented, trained in Xvfb and rebuilt with the profile
+// Every profile has its own objects, so switching back and forth doesn't rebuild
+typedef struct
 {
-    WIZ_BUILD_INIT(argc, argv);
-    command_t compile = MAKE_CMD(BIN(COMPILER), DEBUG_FLAGS, "-o", OUTPUT);
+    const char* name;
+    const char* output;
+    command_t flags; // Used for compiling and linking
+} profile_t;
 
+static bool profile_init(const char* name, profile_t* profile)
+{
+    profile->name = name;
+    profile->output = STRCMP(name, "debug") ? OUTPUT : STRCAT(OUTPUT "-", name);
+
+    if(STRCMP(name, "debug"))
+        profile->flags = MAKE_CMD("-g", CFLAGS);
+    else if(STRCMP(name, "release"))
+        profile->flags = MAKE_CMD("-O2", "-flto", CFLAGS);
+    else if(STRCMP(name, "asan"))
+        profile->flags = MAKE_CMD("-g", "-O1", "-fno-omit-frame-pointer", "-fsanitize=address,undefined", CFLAGS);
+    else if(STRCMP(name, "pgo-gen"))
+        profile->flags = MAKE_CMD("-O2", "-flto", "-fprofile-instr-generate", CFLAGS);
+    else if(STRCMP(name, "pgo"))
+        profile->flags = MAKE_CMD("-O2", "-flto", "-fprofile-instr-use=" PROFILE_DATA, CFLAGS);
+    else
+        return false;
+    return true;
+}
+
+// src/main.c -> <dir>main.o, <dir>main.d
+static char* object_path(const char* dir, const char* file_name, const char* extension)
+{
+    char* path = STRCAT(dir, file_name);
+    path[strlen(path) - 1] = '\0'; // Drop the "c" from ".c"
+    return STRCAT(path, extension);
+}
+
+// Compiles the stale objects of a profile and links them if needed
+// extra is a file every object depends on on top of its headers, e.g. the PGO data
+static bool build(jobs_t* jobs, const profile_t* profile, const char* extra, size_t* rebuilt)
+{
+    char* obj_dir = STRCAT(STRCAT(OBJ_DIR, profile->name), "/");
+    command_t link = MAKE_CMD(BIN(COMPILER), "-o", profile->output);
+    size_t stale = 0;
+    bool relink = false;
+
+    (void)mkdir(obj_dir, 0755);
+
+    // The flags live in this file, so it counts as a dependency of everything
     size_t files =
-        FOR_FILE_IN_DIR("./src/", WHERE( FILE_FORMAT("c") ),
-            CMD_APPEND(&compile, FILE_PATH); 
-            LOG("Adding " BLUE("%s") " to build", FILE_NAME);
+        FOR_FILE_IN_DIR(SRC_DIR, WHERE( FILE_FORMAT("c") ),
+            char* object = object_path(obj_dir, FILE_NAME, "o");
+            char* dep_file = object_path(obj_dir, FILE_NAME, "d");
+
+            CMD_APPEND(&link, object);
+            if(build_is_stale(object, dep_file, "./wiz_build.c")
+                    || (extra != NULL && build_is_stale(object, NULL, extra)))
+            {
+                command_t compile = MAKE_CMD(BIN(COMPILER), "-MMD", "-MF", dep_file, "-c", FILE_PATH, "-o", object);
+                command_append_arg(&compile, profile->flags);
+                LOG("Compiling " BLUE("%s") " (%s)", FILE_NAME, profile->name);
+                jobs_spawn(jobs, compile);
+                stale++;
+            }
+            else if(build_is_stale(profile->output, NULL, object))
+                relink = true; // Last link failed or got interrupted
             );
 
     ASSERT(files > 0);
+    *rebuilt += stale;
+
+    if(jobs_wait(jobs) > 0)
+    {
+        LOG("Compilation has " RED("FAILED"));
+        return false;
+    }
+
+    // NOTE: Deleting a source file doesn't cause a relink by itself,
+    // rm the binary after doing that
+    if(stale == 0 && !relink && FILE_EXISTS(profile->output) == 0)
+        return true;
+
+    command_append_arg(&link, profile->flags);
+    CMD_APPEND(&link, LIBS);
+    LOG("Linking " BLUE("%s"), profile->output);
+    jobs_spawn(jobs, link);
+    if(jobs_wait(jobs) > 0)
+    {
+        LOG("Linking of " BLUE("%s") " has " RED("FAILED"), profile->output);
+        return false;
+    }
+    return true;
+}
 
-    SET_COMPILE_TARGET(OUTPUT);
-    EXEC_CMD(compile);
-    CHECK_COMPILE_STATUS();
+// Standalone tools, one source file each
+static bool build_tool(jobs_t* jobs, const char* source, const char* deps, const char* output, command_t flags)
+{
+    if(!build_is_stale(output, deps, "./wiz_build.c"))
+        return true;
+
+    command_t compile = MAKE_CMD(BIN(COMPILER), "-MMD", "-MF", deps, source, "-o", output);
+    command_append_arg(&compile, flags);
+    LOG("Compiling " BLUE("%s"), source);
+    jobs_spawn(jobs, compile);
+    if(jobs_wait(jobs) > 0)
+    {
+        LOG("Compilation of " BLUE("%s") " has " RED("FAILED"), output);
+        return false;
+    }
+    return true;
+}
+
+// Sends SIGKILL if it isn't gone after 5s
+static int wait_or_kill(pid_t pid)
+{
+    struct timespec pause = { 0, 10000000 };
+    int status = 0;
+
+    for(int i = 0; i < 500; i++)
+    {
+        if(waitpid(pid, &status, WNOHANG) == pid)
+            return status;
+        nanosleep(&pause, NULL);
+    }
+    kill(pid, SIGKILL);
+    waitpid(pid, &status, 0);
+    return status;
+}
+
+static bool exited_ok(int status)
+{
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+// Runs workload against wm in a throwaway Xvfb with config as $TILE_WM_CONFIG, returns
+// the workload's exit status. The WM is stopped with "tile_wmc quit" after, its status goes to wm_status
+static int xvfb_run(const char* wm, const char* config, command_t workload, int* wm_status)
+{
+    struct timespec pause = { 0, 10000000 };
+    const char* old_display = getenv("DISPLAY");
+    char* display = old_display != NULL ? STRDUP(old_display) : NULL;
+    pid_t server = 0, wm_pid = 0;
+    int status = 0;
+
+    // Never the user's config, someone's compositor or rules would skew the numbers
+    setenv("DISPLAY", ":" TRAIN_DISPLAY_NUMBER, 1);
+    setenv("TILE_WM_CONFIG", config, 1);
+    // Set if this runs inside the WM, the tools would talk to that one
+    // and the WM in Xvfb couldn't open its socket
+    unsetenv("TILE_WM_SOCKET");
+
+    server = command_spawn(MAKE_CMD(BIN("Xvfb"), ":" TRAIN_DISPLAY_NUMBER,
+                "-screen", "0", "1920x1080x24", "-nolisten", "tcp"));
+    for(int i = 0; i < 500 && access("/tmp/.X11-unix/X" TRAIN_DISPLAY_NUMBER, F_OK) != 0; i++)
+        nanosleep(&pause, NULL);
+
+    wm_pid = command_spawn(MAKE_CMD(wm));
+    // Waits for the WM's socket by itself
+    ASSERT(waitpid(command_spawn(workload), &status, 0) >= 0);
+
+    // Clean exit, the profile/leak report only gets written from atexit()
+    CMD(CLIENT_OUTPUT, "quit");
+    *wm_status = wait_or_kill(wm_pid);
+    kill(server, SIGTERM);
+    (void)wait_or_kill(server);
+
+    if(display != NULL)
+        setenv("DISPLAY", display, 1);
+    else
+        unsetenv("DISPLAY");
+    unsetenv("TILE_WM_CONFIG");
+    return status;
+}
+
+// Runs tools/wm_train.c against wm
+// result can be NULL, otherwise the handler latency medians end up in there
+static bool train(const char* wm, const char* result)
+{
+    int wm_status = 0, status = 0;
 
-    LOG("Running " OUTPUT);
+    LOG("Training " BLUE("%s") " in Xvfb :" TRAIN_DISPLAY_NUMBER, wm);
+    setenv("LLVM_PROFILE_FILE", PROFILE_RAW, 1);
+    status = xvfb_run(wm, PGO_DIR "config", MAKE_CMD(TRAIN_OUTPUT, "20", "8", result), &wm_status);
+    unsetenv("LLVM_PROFILE_FILE");
 
-    if(argc > 1 && STRCMP(argv[1], "gdb"))
-        CMD(BIN("gdb"), OUTPUT);
-    else if(argc > 1 && STRCMP(argv[1], "val"))
-        CMD(BIN("valgrind"), OUTPUT);
-    else if(argc > 1 && STRCMP(argv[1], "run"))
+    if(!exited_ok(status))
+    {
+        LOG("Training run " RED("FAILED") ", is Xvfb installed?");
+        return false;
+    }
+    return true;
+}
+
+// Maps and gets rid of WIZ_SOAK_CYCLES windows(a million by default) and
+// fails if clients, X resources, fds or zombies of the WM keep growing
+// Best with the asan profile, a leaked heap block fails the WM's exit then
+static bool soak(const char* wm)
+{
+    const char* cycles = getenv("WIZ_SOAK_CYCLES");
+    int wm_status = 0, status = 0;
+
+    LOG("Soaking " BLUE("%s") " in Xvfb :" TRAIN_DISPLAY_NUMBER, wm);
+    status = xvfb_run(wm, PGO_DIR "config", MAKE_CMD(SOAK_OUTPUT, cycles != NULL ? cycles : "1000000"), &wm_status);
+
+    if(!exited_ok(status))
+    {
+        LOG("Soak " RED("FAILED") ", see the numbers above");
+        return false;
+    }
+    if(!exited_ok(wm_status))
+    {
+        LOG("Soak " RED("FAILED") ", %s didn't exit cleanly", wm);
+        return false;
+    }
+    LOG("Soak " GREEN("SUCCEEDED"));
+    return true;
+}
+
+// Runs tools/binding_test.c against wm with tools/binding_test.conf
+static bool test(const char* wm)
+{
+    int wm_status = 0, status = 0;
+
+    LOG("Testing bindings of " BLUE("%s") " in Xvfb :" TRAIN_DISPLAY_NUMBER, wm);
+    status = xvfb_run(wm, BINDING_TEST_CONFIG, MAKE_CMD(BINDING_TEST_OUTPUT), &wm_status);
+
+    if(!exited_ok(status))
+    {
+        LOG("Binding test " RED("FAILED") ", see above");
+        return false;
+    }
+    LOG("Binding test " GREEN("SUCCEEDED"));
+    return true;
+}
+
+static bool read_result(const char* path, long long medians[3])
+{
+    FILE* fp = fopen(path, "r");
+    bool ok = fp != NULL && fscanf(fp, "%lld %lld %lld", &medians[0], &medians[1], &medians[2]) == 3;
+
+    if(fp != NULL)
+        fclose(fp);
+    return ok;
+}
+
+// Instrumented build -> training -> build with the profile,
+// then both release and PGO binaries get the same workload to compare
+static bool build_pgo(jobs_t* jobs, const profile_t* profile, size_t* rebuilt)
+{
+    const char* names[3] = { "map", "command", "close" };
+    long long before[3], after[3];
+    profile_t release, generate;
+
+    (void)profile_init("release", &release);
+    (void)profile_init("pgo-gen", &generate);
+    (void)mkdir(PGO_DIR, 0755);
+
+    if(!build(jobs, &release, NULL, rebuilt) || !build(jobs, &generate, NULL, rebuilt))
+        return false;
+    if(!build_tool(jobs, TRAIN_SRC, TRAIN_DEPS, TRAIN_OUTPUT, MAKE_CMD("-O2", "-Wall", "-Wextra", "-lX11")))
+        return false;
+
+    // Only retrained when the instrumented binary or the workload changed
+    if(build_is_stale(PROFILE_DATA, NULL, generate.output) || build_is_stale(PROFILE_DATA, NULL, TRAIN_OUTPUT))
+    {
+        (void)unlink(PROFILE_RAW);
+        if(!train(generate.output, NULL))
+            return false;
+        CMD(BIN("llvm-profdata"), "merge", "-o", PROFILE_DATA, PROFILE_RAW);
+        if(build_is_stale(PROFILE_DATA, NULL, PROFILE_RAW))
+        {
+            LOG("Merging " BLUE("%s") " has " RED("FAILED"), PROFILE_RAW);
+            return false;
+        }
+    }
+
+    if(!build(jobs, profile, PROFILE_DATA, rebuilt))
+        return false;
+
+    // Back to back on the same setup
+    if(!train(release.output, PGO_DIR "release.txt") || !train(profile->output, PGO_DIR "pgo.txt"))
+        return false;
+    if(!read_result(PGO_DIR "release.txt", before) || !read_result(PGO_DIR "pgo.txt", after))
+        return false;
+
+    LOG("Handler latency(median), release -> pgo:");
+    for(int i = 0; i < 3; i++)
+    {
+        LOG("  %-8s %8.3fms -> %8.3fms  " MAGENTA("%+.1f%%"), names[i], before[i] / 1e6, after[i] / 1e6,
+                before[i] > 0 ? (after[i] - before[i]) * 100.0 / before[i] : 0.0);
+    }
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    WIZ_BUILD_INIT(argc, argv);
+    // WIZ_JOBS=N overrides it, defaults to one job per core
+    const char* jobs_env = getenv("WIZ_JOBS");
+    jobs_t jobs = jobs_init(jobs_env != NULL ? strtoul(jobs_env, NULL, 10) : 0);
+    const char* mode = argc > 1 ? argv[1] : "";
+    struct timespec begin, end;
+    profile_t profile;
+    size_t rebuilt = 0;
+    bool ok = false;
+
+    if(!profile_init(mode, &profile) || STRCMP(mode, "pgo-gen"))
+        (void)profile_init("debug", &profile);
+    else
+        mode = argc > 2 ? argv[2] : "";
+
+    clock_gettime(CLOCK_MONOTONIC_RAW, &begin);
+    (void)mkdir("./bin", 0755);
+    (void)mkdir(OBJ_DIR, 0755);
+
+    // IPC client, see src/ipc.h
+    ok = build_tool(&jobs, CLIENT_SRC, CLIENT_DEPS, CLIENT_OUTPUT, MAKE_CMD(DEBUG_FLAGS));
+
+    if(ok && STRCMP(profile.name, "pgo"))
+        ok = build_pgo(&jobs, &profile, &rebuilt);
+    else if(ok)
+        ok = build(&jobs, &profile, NULL, &rebuilt);
+
+    // Only built on request, needs libXtst
+    if(ok && STRCMP(mode, "bench"))
+        ok = build_tool(&jobs, BENCH_SRC, BENCH_DEPS, BENCH_OUTPUT, MAKE_CMD("-O2", "-Wall", "-Wextra", "-lX11", "-lXtst"));
+    // Same for the soak test, needs libXRes
+    if(ok && STRCMP(mode, "soak"))
+        ok = build_tool(&jobs, SOAK_SRC, SOAK_DEPS, SOAK_OUTPUT, MAKE_CMD("-O2", "-Wall", "-Wextra", "-lX11", "-lXRes"));
+    if(ok && STRCMP(mode, "test"))
+        ok = build_tool(&jobs, BINDING_TEST_SRC, BINDING_TEST_DEPS, BINDING_TEST_OUTPUT, MAKE_CMD("-O2", "-Wall", "-Wextra", "-lX11", "-lXtst"));
+
+    if(!ok)
+        WIZ_BUILD_FAIL();
+
+    clock_gettime(CLOCK_MONOTONIC_RAW, &end);
+    LOG("Build of " BLUE("%s") " " GREEN("SUCCEEDED") ", %zu objects rebuilt in " MAGENTA("%.4f") "s",
+            profile.output, rebuilt, (end.tv_nsec - begin.tv_nsec) / 1000000000.0 + (end.tv_sec - begin.tv_sec));
+
+    if(STRCMP(mode, "bench"))
+    {
+        WIZ_BUILD_DEINIT();
+        return 0;
+    }
+    if(STRCMP(mode, "soak"))
+    {
+        if(!soak(profile.output))
+            WIZ_BUILD_FAIL();
+        WIZ_BUILD_DEINIT();
+    }
+    if(STRCMP(mode, "test"))
+    {
+        if(!test(profile.output))
+            WIZ_BUILD_FAIL();
+        WIZ_BUILD_DEINIT();
+    }
+
+    LOG("Running %s", profile.output);
+    setenv("TILE_WM", profile.output, 1); // For xinitrc
+
+    if(STRCMP(mode, "gdb"))
+        CMD(BIN("gdb"), profile.output);
+    else if(STRCMP(mode, "val"))
+        CMD(BIN("valgrind"), profile.output);
+    else if(STRCMP(mode, "run"))
         CMD(BIN("startx"), "./xinitrc", "--", BIN("Xephyr"), ":1", "-ac", "-screen", "1920x1080" );
-    else if(argc > 1 && STRCMP(argv[1], "startx"))
+    else if(STRCMP(mode, "startx"))
         CMD(BIN("startx"), "./xinitrc", "--", ":1", "-ac" );
-    
+
     WIZ_BUILD_DEINIT();
     return 0;
 }
-
@@ -12,6 +12,7 @@
 #include<sys/wait.h>
 #include<time.h>
 #include<dlfcn.h>
+#include<stdbool.h>
 
 // NOTE: Replacement has been made
 // REPLACE ALL ASSERTS WITH OWN IMPLEMENTATION
@@ -23,7 +24,7 @@
 // everything rather than making seperate mallocs
 // Some "frees" are made throughout by placing "free points" and
 // moving the memory pointer back to that point
-#define MAX_MEMORY 1024 * 4
+#define MAX_MEMORY 1024 * 64
 static void* wiz_memory; 
 static void* memory_ptr, *free_point;
 static size_t max_alloc;
@@ -72,8 +73,27 @@ typedef struct
 command_t command_init(const char* command, ...); 
 void command_append_arg(command_t* command, command_t command_to_append);
 void command_execute(command_t command);
+pid_t command_spawn(command_t command); // Doesn't wait, returns the child
 
 
+// INCREMENTAL BUILDS
+// Targets compiled with -MMD -MF <dep_file> get a make style list of everything
+// that went into them, a target is stale if it or its dep file is missing or if
+// anything on that list(or extra, e.g. the build script itself) is newer
+// dep_file can be NULL to only compare against extra
+bool build_is_stale(const char* target, const char* dep_file, const char* extra);
+
+// Runs up to max commands at once
+typedef struct
+{
+    pid_t* pids;
+    size_t len, max;
+    size_t failed;
+} jobs_t;
+jobs_t jobs_init(size_t max); // 0 = number of cores
+void jobs_spawn(jobs_t* jobs, command_t command); // Blocks while all slots are busy
+size_t jobs_wait(jobs_t* jobs); // Waits for everything, returns how many jobs failed
+
 // NOTE: Welcome to macro land
 #define MAKE_CMD(...)\
     command_init(__VA_ARGS__, NULL)
@@ -287,13 +307,15 @@ file_t compile_target;
 
 // wiz_build self-rebuild + alloc scratch
 #define WIZ_BUILD_INIT(ARGC, ARGV) wiz_build_init(ARGC, ARGV)
-#define WIZ_BUILD_DEINIT() wiz_build_deinit()
+#define WIZ_BUILD_DEINIT() wiz_build_exit(0)
+#define WIZ_BUILD_FAIL() wiz_build_exit(1) // Same, but the caller sees the build failed
 void wiz_build_init(int argc, char **argv);
 void wiz_build_deinit();
+void wiz_build_exit(int status);
 
 #define PANIC(...)\
     ERROR(__VA_ARGS__);\
-    wiz_build_deinit();
+    wiz_build_exit(1);
 
 
 // ## Function definitions
@@ -531,6 +553,143 @@ void command_execute(command_t command)
     }
 }
 
+static bool mtime_newer(const struct stat* a, const struct stat* b)
+{
+    if(a->st_mtim.tv_sec != b->st_mtim.tv_sec)
+        return a->st_mtim.tv_sec > b->st_mtim.tv_sec;
+    return a->st_mtim.tv_nsec > b->st_mtim.tv_nsec;
+}
+
+bool build_is_stale(const char* target, const char* dep_file, const char* extra)
+{
+    struct stat target_info, info;
+    FILE* fp = NULL;
+    char* buffer = NULL;
+    long len = 0;
+    bool stale = false;
+
+    if(stat(target, &target_info) != 0)
+        return true;
+    if(extra != NULL && stat(extra, &info) == 0 && mtime_newer(&info, &target_info))
+        return true;
+    if(dep_file == NULL)
+        return false;
+
+    fp = fopen(dep_file, "r");
+    if(fp == NULL)
+        return true;
+
+    // Not from the scratch pad, dep files of big translation units get long
+    fseek(fp, 0, SEEK_END);
+    len = ftell(fp);
+    rewind(fp);
+    buffer = malloc(len + NULL_TERMINATOR);
+    if(buffer == NULL || fread(buffer, 1, len, fp) != (size_t)len)
+    {
+        free(buffer);
+        fclose(fp);
+        return true;
+    }
+    buffer[len] = '\0';
+    fclose(fp);
+
+    // "target.o: a.c b.h c.h", long lists get split with backslash newlines
+    char* path = strchr(buffer, ':');
+    if(path == NULL)
+        stale = true;
+    else
+        path++;
+
+    while(!stale && path != NULL)
+    {
+        while(*path == ' ' || *path == '\t' || *path == '\n' || *path == '\\')
+            path++;
+        if(*path == '\0')
+            break;
+
+        char* end = path + strcspn(path, " \t\n");
+        char saved = *end;
+        *end = '\0';
+
+        // A prerequisite that's gone(renamed header) also means rebuild
+        if(stat(path, &info) != 0 || mtime_newer(&info, &target_info))
+            stale = true;
+
+        *end = saved;
+        path = end;
+    }
+
+    free(buffer);
+    return stale;
+}
+
+jobs_t jobs_init(size_t max)
+{
+    jobs_t jobs = {0};
+
+    if(max == 0)
+    {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        max = cores > 0 ? (size_t)cores : 1;
+    }
+
+    jobs.pids = wiz_allocate(sizeof(pid_t) * max);
+    jobs.max = max;
+    return jobs;
+}
+
+static void jobs_reap_one(jobs_t* jobs)
+{
+    int status = 0;
+    pid_t pid = wait(&status);
+
+    ASSERT(pid >= 0);
+    if(!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        jobs->failed++;
+
+    for(size_t i = 0; i < jobs->len; i++)
+    {
+        if(jobs->pids[i] != pid)
+            continue;
+        jobs->pids[i] = jobs->pids[--jobs->len];
+        break;
+    }
+}
+
+void jobs_spawn(jobs_t* jobs, command_t command)
+{
+    while(jobs->len == jobs->max)
+        jobs_reap_one(jobs);
+
+    jobs->pids[jobs->len++] = command_spawn(command);
+}
+
+size_t jobs_wait(jobs_t* jobs)
+{
+    size_t failed = 0;
+
+    while(jobs->len > 0)
+        jobs_reap_one(jobs);
+
+    failed = jobs->failed;
+    jobs->failed = 0;
+    return failed;
+}
+
+pid_t command_spawn(command_t command)
+{
+    pid_t pid = fork();
+    ASSERT(pid >= 0);
+
+    if(pid == 0)
+    {
+        (void)execvp(command.args[0], command.args);
+        fprintf(stderr, "ERRNO: %s\n", strerror(errno));
+        _exit(127);
+    }
+    return pid;
+}
+
 void wiz_build_init(int argc, char **argv)
 {
     LOG("Running in debug mode");
@@ -561,7 +720,7 @@ void wiz_build_init(int argc, char **argv)
         if(last_modified == bin_file.file_info.st_mtim.tv_nsec)
         {
             LOG("Compilation of " BLUE("%s") " has " RED("FAILED") "\n", src_file.file_path);
-            wiz_build_deinit();
+            wiz_build_exit(1);
         }else
         {
             LOG("Compilation of " BLUE("%s") " has " GREEN("SUCCEEDED") " in " MAGENTA("%.4f") "s\n",
@@ -582,6 +741,11 @@ void wiz_build_init(int argc, char **argv)
 }
 
 void wiz_build_deinit()
+{
+    wiz_build_exit(0);
+}
+
+void wiz_build_exit(int status)
 {
     size_t used_memory = (size_t)(memory_ptr - wiz_memory);
     free(wiz_memory);
@@ -589,7 +753,7 @@ void wiz_build_deinit()
 
     LOG(YELLOW("%zu/%d") " peak bytes allocated", max_alloc, MAX_MEMORY);
     LOG(YELLOW("%zu/%d") " bytes allocated on exit", used_memory, MAX_MEMORY);
-    exit(0);
+    exit(status);
 }
 
 